@@ -0,0 +1,27 @@
+#version 330 core
+in vec2 TexCoords;
+
+uniform sampler2D scene;
+uniform sampler2D gDepth;
+
+layout(location = 0) out vec4 brights;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec3 color = texelFetch(scene, texel, 0).rgb;
+	// The forward path's brights attachment keeps the clear color where nothing is drawn
+	if (texelFetch(gDepth, texel, 0).r >= 1.0) {
+		brights = vec4(color, 1.0);
+		return;
+	}
+
+	// Same threshold as the scene shader
+	float brightnessThreshold = dot(color, vec3(0.3126, 0.7152, 0.1722));
+	if (brightnessThreshold > 0.90f) {
+		brights = vec4(color, 1.0f);
+	}
+	else {
+		brights = vec4(vec3(0), 1.0f);
+	}
+}
@@ -0,0 +1,59 @@
+#version 330 core
+in vec3 fragNormal;
+in vec3 fragPosition;
+in vec2 fragTexture;
+
+uniform sampler2D globeTexture;
+
+// Unused light slots, which act as lights at the origin
+uniform int numIdleLights;
+uniform vec3 shapeColor;
+uniform float shininess;
+uniform bool isLightSource;
+uniform bool isGlobeSphere;
+
+// Lit scene color, which the light volumes add to
+layout(location = 0) out vec4 color;
+// Normal, with w = 1 marking light sources that take no lighting
+layout(location = 2) out vec4 gNormal;
+// Surface color and shininess
+layout(location = 3) out vec4 gAlbedo;
+
+// Fixed light color
+vec3 lightColor = vec3(0.85, 0.80, 0.75);
+// Size of the scene shader's light array, which the sum is divided by
+const float LIGHT_SLOTS = 500.0;
+
+vec3 calculatePointLight(vec3 lightPosition, vec3 N, vec3 shapeColorIn) {
+	// Fixed camera position
+	vec3 camPosition = vec3(0);
+
+	vec3 L = normalize(lightPosition - fragPosition);
+	vec3 V = normalize(camPosition - fragPosition);
+	vec3 R = reflect(-L, N);
+	// attenuation
+	float distance = length(lightPosition - fragPosition);
+	float attenuation = 1.0f / (distance * distance);
+	// combine results
+	vec3 ambient = 0.05f * lightColor;
+	vec3 diffuse = max(dot(N, L), 0) * lightColor;
+	vec3 specular = pow(max(dot(V, R), 0), shininess) * lightColor;
+
+	return (ambient + diffuse + specular) * attenuation * shapeColorIn;
+}
+
+void main() {
+	vec3 N = normalize(fragNormal);
+	vec3 surfaceColor = isGlobeSphere ? texture(globeTexture, fragTexture).rgb : shapeColor;
+
+	gNormal = vec4(N, isLightSource ? 1.0 : 0.0);
+	gAlbedo = vec4(surfaceColor, shininess);
+
+	if (isLightSource) {
+		color = vec4(lightColor, 1.0);
+	} else {
+		// Idle slots all sit at the origin, so they are one light for the whole
+		// screen; the light volumes add the live fireflies on top
+		color = vec4(float(numIdleLights) * calculatePointLight(vec3(0), N, surfaceColor) / LIGHT_SLOTS, 1.0);
+	}
+}
@@ -0,0 +1,59 @@
+#version 330 core
+flat in vec3 lightPosition;
+
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+uniform sampler2D gDepth;
+// Back from window depth to world space
+uniform mat4 inversePV;
+uniform vec2 viewportSize;
+uniform float lightRadius;
+
+out vec4 color;
+
+// Fixed light color
+vec3 lightColor = vec3(0.85, 0.80, 0.75);
+// Size of the scene shader's light array, which the sum is divided by
+const float LIGHT_SLOTS = 500.0;
+
+vec3 calculatePointLight(vec3 fragPosition, vec3 N, vec3 shapeColorIn, float shininess) {
+	// Fixed camera position
+	vec3 camPosition = vec3(0);
+
+	vec3 L = normalize(lightPosition - fragPosition);
+	vec3 V = normalize(camPosition - fragPosition);
+	vec3 R = reflect(-L, N);
+	// attenuation
+	float distance = length(lightPosition - fragPosition);
+	float attenuation = 1.0f / (distance * distance);
+	// combine results
+	vec3 ambient = 0.05f * lightColor;
+	vec3 diffuse = max(dot(N, L), 0) * lightColor;
+	vec3 specular = pow(max(dot(V, R), 0), shininess) * lightColor;
+
+	return (ambient + diffuse + specular) * attenuation * shapeColorIn;
+}
+
+void main() {
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	float depth = texelFetch(gDepth, texel, 0).r;
+	vec4 normal = texelFetch(gNormal, texel, 0);
+	// Background and light sources take no lighting
+	if (depth >= 1.0 || normal.w > 0.5) {
+		discard;
+	}
+
+	vec4 ndc = vec4(vec3(gl_FragCoord.xy / viewportSize, depth) * 2.0 - 1.0, 1.0);
+	vec4 world = inversePV * ndc;
+	vec3 fragPosition = world.xyz / world.w;
+	float distance = length(lightPosition - fragPosition);
+	if (distance >= lightRadius) {
+		discard;
+	}
+
+	// Fade out towards the edge of the volume so its boundary doesn't show
+	float edge = distance / lightRadius;
+	float window = 1.0 - edge * edge * edge * edge;
+	vec4 albedo = texelFetch(gAlbedo, texel, 0);
+	color = vec4(calculatePointLight(fragPosition, normal.xyz, albedo.rgb, albedo.a) * window * window / LIGHT_SLOTS, 1.0);
+}
@@ -0,0 +1,22 @@
+#version  330 core
+// Vertex of a unit sphere bounding mesh
+layout(location = 0) in vec3 vertPos;
+// Per instance, position and mass (mass <= 0 is a dead slot)
+layout(location = 1) in vec4 instancePositionMass;
+
+uniform mat4 P;
+uniform mat4 V;
+uniform float lightRadius;
+
+flat out vec3 lightPosition;
+
+void main()
+{
+	lightPosition = instancePositionMass.xyz;
+	gl_Position = P * V * vec4(lightPosition + vertPos * lightRadius, 1.0);
+
+	// Push dead slots outside the clip volume
+	if (instancePositionMass.w <= 0.0) {
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+	}
+}
@@ -0,0 +1,7 @@
+#version 330 core
+// Never runs, the update pass draws with rasterizer discard
+out vec4 color;
+
+void main() {
+	color = vec4(0);
+}
@@ -0,0 +1,72 @@
+#version 330 core
+// One particle per vertex: xyz position + mass, xyz velocity + seed
+layout(location = 0) in vec4 inPositionMass;
+layout(location = 1) in vec4 inVelocitySeed;
+
+uniform float dt;
+uniform uint frame;
+uniform bool isGravityOn;
+uniform bool isCenterPointAttractive;
+uniform vec3 centerPoint;
+uniform float domainHalfExtent;
+uniform int numMagnets;
+uniform vec3 magnets[64];
+
+out vec4 outPositionMass;
+out vec4 outVelocitySeed;
+
+// Integer hash (lowbias32), good enough for jitter
+uint hash(uint x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float randomFloat(uint seed, uint stream, float lowBound, float highBound) {
+	uint h = hash(seed ^ hash(frame * 4u + stream));
+	return float(h) / 4294967295.0 * (highBound - lowBound) + lowBound;
+}
+
+void main() {
+	vec3 position = inPositionMass.xyz;
+	float mass = inPositionMass.w;
+	vec3 velocity = inVelocitySeed.xyz;
+	uint seed = uint(inVelocitySeed.w);
+
+	// Dead slots are carried over untouched
+	if (mass > 0.0) {
+		vec3 force = vec3(0);
+
+		// Center point attraction
+		if (isCenterPointAttractive) {
+			vec3 towardsCenter = centerPoint - position;
+			float distFromCenter = length(towardsCenter) / 25.0;
+			force += distFromCenter * randomFloat(seed, 0u, 0.1, 0.25) * towardsCenter;
+		}
+		// Gravity
+		if (isGravityOn) {
+			force += vec3(0, -0.25, 0);
+		}
+		// Magnet repulsion
+		for (int i = 0; i < numMagnets; i++) {
+			vec3 away = position - magnets[i];
+			if (length(away) < 1.0) force += away;
+		}
+		// Fly flight jitter
+		force += vec3(randomFloat(seed, 1u, -0.05, 0.05), randomFloat(seed, 2u, -0.05, 0.05), randomFloat(seed, 3u, -0.05, 0.05));
+
+		velocity += force / mass * dt;
+		position += velocity * dt;
+
+		// Retire particles that leave the domain
+		if (any(greaterThanEqual(abs(position - centerPoint), vec3(domainHalfExtent)))) {
+			mass = 0.0;
+		}
+	}
+
+	outPositionMass = vec4(position, mass);
+	outVelocitySeed = vec4(velocity, inVelocitySeed.w);
+}
@@ -0,0 +1,29 @@
+#version  330 core
+layout(location = 0) in vec3 vertPos;
+layout(location = 1) in vec3 vertNor;
+layout(location = 2) in vec2 vertTex;
+// Per instance, straight from the simulation buffer
+layout(location = 3) in vec4 instancePositionMass;
+
+uniform mat4 P;
+uniform mat4 V;
+uniform float particleScale;
+
+out vec3 fragNormal;
+out vec3 fragPosition;
+out vec2 fragTexture;
+
+void main()
+{
+	vec3 worldPos = instancePositionMass.xyz + vertPos * particleScale;
+	gl_Position = P * V * vec4(worldPos, 1.0);
+
+	// Push dead slots outside the clip volume
+	if (instancePositionMass.w <= 0.0) {
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+	}
+
+	fragPosition = worldPos;
+	fragNormal = vertNor;
+	fragTexture = vertTex;
+}
@@ -6,6 +6,17 @@ in vec2 fragTexture;
 uniform sampler2D globeTexture;
 
 uniform vec3 lights[500];
+// Lights actually filled in
+uniform int numLights;
+// Unused slots, which act as lights at the origin
+uniform int numIdleLights;
+// GPU simulation keeps fireflies in a buffer texture, two texels per particle.
+// Slots form a ring, so the lights are the newest ones, starting at slot
+// lightBufferStart and wrapping at lightBufferSlots.
+uniform bool useLightBuffer;
+uniform samplerBuffer lightBuffer;
+uniform int lightBufferStart;
+uniform int lightBufferSlots;
 uniform vec3 shapeColor;
 uniform float shininess;
 uniform bool isLightSource;
@@ -36,6 +47,15 @@ vec3 calculatePointLight(vec3 lightPosition, vec3 shapeColorIn) {
 	return (ambient + diffuse + specular) * attenuation * shapeColorIn;
 }
 
+// Position of light i, or w = 0 for a dead GPU particle
+vec4 getLight(int i) {
+	if (useLightBuffer) {
+		vec4 positionMass = texelFetch(lightBuffer, 2 * ((lightBufferStart + i) % lightBufferSlots));
+		return vec4(positionMass.xyz, positionMass.w > 0.0 ? 1.0 : 0.0);
+	}
+	return vec4(lights[i], 1.0);
+}
+
 void main() {
 	// Output light color if its a firefly
 	if (isLightSource) {
@@ -44,11 +64,19 @@ void main() {
 		// Initialization of variables
 		vec3 result = vec3(0);
 
-		// Summation calculation for multiple lights
-		for (int i = 0; i < lights.length(); i++) {
-			vec3 texSample = texture(globeTexture, fragTexture).rgb;
-			result += calculatePointLight(lights[i], isGlobeSphere ? texSample : shapeColor);
+		vec3 texSample = texture(globeTexture, fragTexture).rgb;
+		vec3 surfaceColor = isGlobeSphere ? texSample : shapeColor;
+
+		// Summation calculation for multiple lights. Dead GPU particles are empty
+		// slots just like the CPU path's unused ones, so they count as idle.
+		int idleLights = numIdleLights;
+		for (int i = 0; i < numLights; i++) {
+			vec4 light = getLight(i);
+			if (light.w > 0.0) result += calculatePointLight(light.xyz, surfaceColor);
+			else idleLights++;
 		}
+		// Idle slots all sit at the origin, so evaluate them once
+		result += float(idleLights) * calculatePointLight(vec3(0), surfaceColor);
 		result /= lights.length();
 
 		// Output normal color to first attachment if not light (layout = 0)
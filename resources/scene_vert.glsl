@@ -11,6 +11,9 @@ out vec3 fragNormal;
 out vec3 fragPosition;
 out vec2 fragTexture;
 
+// The depth pre-pass shares this shader, and its depth must match exactly for GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
 	gl_Position = P * V * M * vec4(vertPos, 1.0);
@@ -0,0 +1,20 @@
+#version 330 core
+in vec2 fragCorner;
+
+layout(location = 0) out vec4 color;
+layout(location = 1) out vec4 brights;
+
+// Same light color the scene shader gives fireflies
+vec3 lightColor = vec3(0.85, 0.80, 0.75);
+
+void main() {
+	float r2 = dot(fragCorner, fragCorner);
+	if (r2 >= 1.0) {
+		discard;
+	}
+	// Soft round falloff, bright core fading to nothing at the rim
+	float falloff = (1.0 - r2) * (1.0 - r2);
+	color = vec4(lightColor * falloff, 1.0);
+	// Fireflies are lights, so they go to the bloom attachment as they are
+	brights = color;
+}
@@ -0,0 +1,26 @@
+#version  330 core
+// Corner of the quad, -1..1, drawn as a four vertex strip
+layout(location = 0) in vec2 vertCorner;
+// Per instance, position and mass (mass <= 0 is a dead slot)
+layout(location = 1) in vec4 instancePositionMass;
+
+uniform mat4 P;
+uniform mat4 V;
+uniform float spriteRadius;
+
+out vec2 fragCorner;
+
+void main()
+{
+	// Expand in view space so the quad always faces the camera
+	vec4 viewPos = V * vec4(instancePositionMass.xyz, 1.0);
+	viewPos.xy += vertCorner * spriteRadius;
+	gl_Position = P * viewPos;
+
+	// Push dead slots outside the clip volume
+	if (instancePositionMass.w <= 0.0) {
+		gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+	}
+
+	fragCorner = vertCorner;
+}
@@ -0,0 +1,296 @@
+#include "../headers/Bvh.h"
+#include "../headers/ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BVH_USE_SSE2
+#endif
+
+namespace
+{
+	const uint32_t LeafSize = 4;
+
+	// Slab test of the segment origin + t * direction, t in [0, tMax], against a box
+	inline bool overlapsBox(const vec3& origin, const vec3& inverseDirection, float tMax, const vec3& low, const vec3& high)
+	{
+		float tNear = 0.0f, tFar = tMax;
+		for (int a = 0; a < 3; a++) {
+			float t0 = (low[a] - origin[a]) * inverseDirection[a];
+			float t1 = (high[a] - origin[a]) * inverseDirection[a];
+			if (t0 > t1) std::swap(t0, t1);
+			tNear = std::max(tNear, t0);
+			tFar = std::min(tFar, t1);
+		}
+		return tNear <= tFar;
+	}
+}
+
+size_t TriangleBvh::addShape(const Shape* shape, const mat4& model)
+{
+	size_t mesh = meshModels.size();
+	meshModels.push_back(model);
+	meshDirty.push_back(false);
+
+	const vector<float>& positions = shape->getPositions();
+	const vector<unsigned int>& indices = shape->getIndices();
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		for (int corner = 0; corner < 3; corner++) {
+			unsigned int v = indices[i + corner];
+			localVertices.push_back(vec3(positions[3 * v], positions[3 * v + 1], positions[3 * v + 2]));
+		}
+		triangleMesh.push_back((uint32_t) mesh);
+	}
+	worldVertices.resize(localVertices.size());
+	updateWorldVertices(mesh);
+	return mesh;
+}
+
+void TriangleBvh::updateWorldVertices(size_t mesh)
+{
+	const mat4& model = meshModels[mesh];
+	for (size_t tri = 0; tri < triangleMesh.size(); tri++) {
+		if (triangleMesh[tri] != mesh) continue;
+		for (int corner = 0; corner < 3; corner++) {
+			worldVertices[3 * tri + corner] = vec3(model * glm::vec4(localVertices[3 * tri + corner], 1.0f));
+		}
+	}
+}
+
+void TriangleBvh::build()
+{
+	size_t count = triangleMesh.size();
+	nodes.clear();
+	packets.clear();
+	packetStart.clear();
+	packetCount.clear();
+	order.resize(count);
+	centroids.resize(count);
+	for (size_t tri = 0; tri < count; tri++) {
+		order[tri] = (uint32_t) tri;
+		centroids[tri] = (worldVertices[3 * tri] + worldVertices[3 * tri + 1] + worldVertices[3 * tri + 2]) / 3.0f;
+	}
+	if (count == 0) return;
+
+	nodes.reserve(2 * count / LeafSize + 1);
+	buildNode(0, (uint32_t) count);
+}
+
+uint32_t TriangleBvh::buildNode(uint32_t begin, uint32_t end)
+{
+	uint32_t index = (uint32_t) nodes.size();
+	nodes.push_back(Node());
+
+	vec3 low(FLT_MAX), high(-FLT_MAX), centroidLow(FLT_MAX), centroidHigh(-FLT_MAX);
+	for (uint32_t i = begin; i < end; i++) {
+		uint32_t tri = order[i];
+		for (int corner = 0; corner < 3; corner++) {
+			low = glm::min(low, worldVertices[3 * tri + corner]);
+			high = glm::max(high, worldVertices[3 * tri + corner]);
+		}
+		centroidLow = glm::min(centroidLow, centroids[tri]);
+		centroidHigh = glm::max(centroidHigh, centroids[tri]);
+	}
+	nodes[index].min = low;
+	nodes[index].max = high;
+
+	if (end - begin <= LeafSize) {
+		nodes[index].count = end - begin;
+		nodes[index].right = (uint32_t) packets.size();
+		packets.push_back(Packet());
+		packetStart.push_back(begin);
+		packetCount.push_back(end - begin);
+		fillPacket(nodes[index].right);
+		return index;
+	}
+
+	// Median split along the widest axis of the centroids
+	vec3 extent = centroidHigh - centroidLow;
+	int axis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+	uint32_t middle = begin + (end - begin) / 2;
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](uint32_t a, uint32_t b) {
+		return centroids[a][axis] < centroids[b][axis];
+	});
+
+	nodes[index].count = 0;
+	buildNode(begin, middle);
+	uint32_t right = buildNode(middle, end);
+	nodes[index].right = right;
+	return index;
+}
+
+void TriangleBvh::fillPacket(uint32_t packet)
+{
+	Packet& p = packets[packet];
+	for (uint32_t lane = 0; lane < LeafSize; lane++) {
+		vec3 v0(0), e1(0), e2(0);
+		if (lane < packetCount[packet]) {
+			uint32_t tri = order[packetStart[packet] + lane];
+			v0 = worldVertices[3 * tri];
+			e1 = worldVertices[3 * tri + 1] - v0;
+			e2 = worldVertices[3 * tri + 2] - v0;
+		}
+		for (int a = 0; a < 3; a++) {
+			p.v0[a][lane] = v0[a];
+			p.e1[a][lane] = e1[a];
+			p.e2[a][lane] = e2[a];
+		}
+	}
+}
+
+void TriangleBvh::setTransform(size_t mesh, const mat4& model)
+{
+	meshModels[mesh] = model;
+	meshDirty[mesh] = true;
+}
+
+void TriangleBvh::refit()
+{
+	bool any = false;
+	for (size_t mesh = 0; mesh < meshModels.size(); mesh++) {
+		if (!meshDirty[mesh]) continue;
+		updateWorldVertices(mesh);
+		meshDirty[mesh] = false;
+		any = true;
+	}
+	if (!any) return;
+
+	// Children always come after their parent, so one backwards sweep is bottom-up
+	for (size_t n = nodes.size(); n-- > 0;) {
+		Node& node = nodes[n];
+		if (node.count > 0) {
+			fillPacket(node.right);
+			vec3 low(FLT_MAX), high(-FLT_MAX);
+			for (uint32_t i = 0; i < node.count; i++) {
+				uint32_t tri = order[packetStart[node.right] + i];
+				for (int corner = 0; corner < 3; corner++) {
+					low = glm::min(low, worldVertices[3 * tri + corner]);
+					high = glm::max(high, worldVertices[3 * tri + corner]);
+				}
+			}
+			node.min = low;
+			node.max = high;
+		}
+		else {
+			const Node& left = nodes[n + 1];
+			const Node& right = nodes[node.right];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+}
+
+bool TriangleBvh::intersectSegment(const vec3& from, const vec3& to, SegmentHit& hit) const
+{
+	hit = SegmentHit();
+	if (nodes.empty()) return false;
+
+	vec3 direction = to - from;
+	if (direction == vec3(0)) return false;
+	vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	float bestT = 1.0f;
+	int bestPacket = -1, bestLane = 0;
+
+	uint32_t stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		uint32_t index = stack[--top];
+		const Node& node = nodes[index];
+		if (!overlapsBox(from, inverseDirection, bestT, node.min, node.max)) continue;
+		if (node.count == 0) {
+			stack[top++] = node.right;
+			stack[top++] = index + 1;
+			continue;
+		}
+
+		// Moller-Trumbore on the four lanes of the leaf packet
+		const Packet& p = packets[node.right];
+#ifdef BVH_USE_SSE2
+		const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+		__m128 e1x = _mm_loadu_ps(p.e1[0]), e1y = _mm_loadu_ps(p.e1[1]), e1z = _mm_loadu_ps(p.e1[2]);
+		__m128 e2x = _mm_loadu_ps(p.e2[0]), e2y = _mm_loadu_ps(p.e2[1]), e2z = _mm_loadu_ps(p.e2[2]);
+		// p = d x e2
+		__m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+		__m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+		__m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+		__m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+		__m128 inverseDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+		// s = origin - v0
+		__m128 sx = _mm_sub_ps(_mm_set1_ps(from.x), _mm_loadu_ps(p.v0[0]));
+		__m128 sy = _mm_sub_ps(_mm_set1_ps(from.y), _mm_loadu_ps(p.v0[1]));
+		__m128 sz = _mm_sub_ps(_mm_set1_ps(from.z), _mm_loadu_ps(p.v0[2]));
+		__m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), inverseDet);
+		// q = s x e1
+		__m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+		__m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+		__m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)), inverseDet);
+		__m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)), inverseDet);
+
+		const __m128 zero = _mm_setzero_ps();
+		__m128 absDet = _mm_andnot_ps(_mm_set1_ps(-0.0f), det);
+		__m128 valid = _mm_cmpgt_ps(absDet, _mm_set1_ps(1e-12f));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(u, zero));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+		valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+		valid = _mm_and_ps(valid, _mm_cmpge_ps(t, zero));
+		valid = _mm_and_ps(valid, _mm_cmplt_ps(t, _mm_set1_ps(bestT)));
+		int mask = _mm_movemask_ps(valid);
+		if (mask != 0) {
+			float lanes[4];
+			_mm_storeu_ps(lanes, t);
+			for (int lane = 0; lane < 4; lane++) {
+				if ((mask & (1 << lane)) && lanes[lane] < bestT) {
+					bestT = lanes[lane];
+					bestPacket = (int) node.right;
+					bestLane = lane;
+				}
+			}
+		}
+#else
+		for (uint32_t lane = 0; lane < node.count; lane++) {
+			vec3 e1(p.e1[0][lane], p.e1[1][lane], p.e1[2][lane]);
+			vec3 e2(p.e2[0][lane], p.e2[1][lane], p.e2[2][lane]);
+			vec3 pv = glm::cross(direction, e2);
+			float det = glm::dot(e1, pv);
+			if (std::abs(det) <= 1e-12f) continue;
+			float inverseDet = 1.0f / det;
+			vec3 s = from - vec3(p.v0[0][lane], p.v0[1][lane], p.v0[2][lane]);
+			float u = glm::dot(s, pv) * inverseDet;
+			vec3 q = glm::cross(s, e1);
+			float v = glm::dot(direction, q) * inverseDet;
+			float t = glm::dot(e2, q) * inverseDet;
+			if (u < 0.0f || v < 0.0f || u + v > 1.0f || t < 0.0f || t >= bestT) continue;
+			bestT = t;
+			bestPacket = (int) node.right;
+			bestLane = (int) lane;
+		}
+#endif
+	}
+
+	if (bestPacket < 0) return false;
+	const Packet& p = packets[bestPacket];
+	vec3 e1(p.e1[0][bestLane], p.e1[1][bestLane], p.e1[2][bestLane]);
+	vec3 e2(p.e2[0][bestLane], p.e2[1][bestLane], p.e2[2][bestLane]);
+	vec3 normal = glm::normalize(glm::cross(e1, e2));
+	if (glm::dot(normal, direction) > 0.0f) normal = -normal;
+
+	hit.hit = true;
+	hit.t = bestT;
+	hit.point = from + bestT * direction;
+	hit.normal = normal;
+	return true;
+}
+
+void TriangleBvh::intersectSegments(const vec3* from, const vec3* to, size_t count, SegmentHit* hits) const
+{
+	ThreadPool::shared().parallelFor(count, 256, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			intersectSegment(from[i], to[i], hits[i]);
+		}
+	});
+}
@@ -0,0 +1,137 @@
+#include "../headers/Checkpoint.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+static const char CheckpointMagic[4] = { 'P', 'I', 'O', 'C' };
+static const uint32_t CheckpointVersion = 3;
+
+static bool writeCheckpoint(const SimulationSnapshot& snapshot, const std::string& path)
+{
+	// Write beside the target and rename, so a crash never leaves half a checkpoint
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not open checkpoint for writing: '" << tempPath << "'" << std::endl;
+		return false;
+	}
+
+	uint32_t toggles = (snapshot.isGravityOn ? 1 : 0) | (snapshot.isMagnetModeOn ? 2 : 0) | (snapshot.isCenterPointAttractive ? 4 : 0) | (snapshot.isFlockingOn ? 8 : 0) | (snapshot.isFluidOn ? 16 : 0) | (snapshot.areEmittersOn ? 32 : 0);
+	uint32_t fireflyCount = (uint32_t) snapshot.fireflies.size();
+	uint32_t magnetCount = (uint32_t) snapshot.magnets.size();
+	uint32_t emitterCount = (uint32_t) snapshot.emitterCarry.size();
+
+	file.write(CheckpointMagic, sizeof(CheckpointMagic));
+	file.write((const char*) &CheckpointVersion, sizeof(CheckpointVersion));
+	file.write((const char*) &snapshot.simStep, sizeof(snapshot.simStep));
+	file.write((const char*) &snapshot.simTime, sizeof(snapshot.simTime));
+	file.write((const char*) &toggles, sizeof(toggles));
+	file.write((const char*) &snapshot.rng, sizeof(snapshot.rng));
+	file.write((const char*) &fireflyCount, sizeof(fireflyCount));
+	file.write((const char*) &magnetCount, sizeof(magnetCount));
+	file.write((const char*) snapshot.fireflies.data(), fireflyCount * sizeof(ParticleRecord));
+	file.write((const char*) snapshot.magnets.data(), magnetCount * sizeof(ParticleRecord));
+	file.write((const char*) &emitterCount, sizeof(emitterCount));
+	file.write((const char*) snapshot.emitterCarry.data(), emitterCount * sizeof(float));
+	file.close();
+	if (!file) {
+		std::cerr << "Failed writing checkpoint '" << tempPath << "'" << std::endl;
+		return false;
+	}
+
+	// rename() won't replace an existing file on Windows
+	std::remove(path.c_str());
+	if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+		std::cerr << "Could not move checkpoint into place: '" << path << "'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+	wait();
+}
+
+bool CheckpointWriter::save(SimulationSnapshot&& snapshot, const std::string& path)
+{
+	if (busy) return false;
+
+	// Previous worker has finished (busy is clear), reap it before starting anew
+	if (worker.joinable()) worker.join();
+	busy = true;
+
+	// The thread owns the snapshot from here on
+	SimulationSnapshot* owned = new SimulationSnapshot(std::move(snapshot));
+	worker = std::thread([this, owned, path]() {
+		writeCheckpoint(*owned, path);
+		delete owned;
+		busy = false;
+	});
+	return true;
+}
+
+void CheckpointWriter::wait()
+{
+	if (worker.joinable()) worker.join();
+}
+
+bool loadCheckpoint(const std::string& path, SimulationSnapshot& snapshot)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return false;
+	}
+	uint64_t fileSize = (uint64_t) file.tellg();
+	file.seekg(0);
+
+	char magic[4];
+	uint32_t version = 0;
+	uint32_t toggles = 0;
+	uint32_t fireflyCount = 0;
+	uint32_t magnetCount = 0;
+	uint32_t emitterCount = 0;
+
+	file.read(magic, sizeof(magic));
+	file.read((char*) &version, sizeof(version));
+	if (!file || std::string(magic, 4) != std::string(CheckpointMagic, 4) || version != CheckpointVersion) {
+		std::cerr << "'" << path << "' is not a checkpoint" << std::endl;
+		return false;
+	}
+	file.read((char*) &snapshot.simStep, sizeof(snapshot.simStep));
+	file.read((char*) &snapshot.simTime, sizeof(snapshot.simTime));
+	file.read((char*) &toggles, sizeof(toggles));
+	file.read((char*) &snapshot.rng, sizeof(snapshot.rng));
+	file.read((char*) &fireflyCount, sizeof(fireflyCount));
+	file.read((char*) &magnetCount, sizeof(magnetCount));
+
+	// Counts the rest of the file can't hold are corrupt, don't allocate for them
+	uint64_t remaining = file ? fileSize - (uint64_t) file.tellg() : 0;
+	if (!file || ((uint64_t) fireflyCount + magnetCount) * sizeof(ParticleRecord) > remaining) {
+		std::cerr << "Checkpoint '" << path << "' is truncated" << std::endl;
+		return false;
+	}
+
+	snapshot.isGravityOn = (toggles & 1) != 0;
+	snapshot.isMagnetModeOn = (toggles & 2) != 0;
+	snapshot.isCenterPointAttractive = (toggles & 4) != 0;
+	snapshot.isFlockingOn = (toggles & 8) != 0;
+	snapshot.isFluidOn = (toggles & 16) != 0;
+	snapshot.areEmittersOn = (toggles & 32) != 0;
+
+	snapshot.fireflies.resize(fireflyCount);
+	snapshot.magnets.resize(magnetCount);
+	file.read((char*) snapshot.fireflies.data(), fireflyCount * sizeof(ParticleRecord));
+	file.read((char*) snapshot.magnets.data(), magnetCount * sizeof(ParticleRecord));
+	file.read((char*) &emitterCount, sizeof(emitterCount));
+	bool carriesFit = file && emitterCount * sizeof(float) <= fileSize - (uint64_t) file.tellg();
+	if (carriesFit) {
+		snapshot.emitterCarry.resize(emitterCount);
+		file.read((char*) snapshot.emitterCarry.data(), emitterCount * sizeof(float));
+	}
+	if (!file || !carriesFit) {
+		std::cerr << "Checkpoint '" << path << "' is truncated" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,245 @@
+#include "../headers/DeferredRenderer.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "../headers/GLSL.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+enum { SceneColor, Brights, Normal, Albedo, Depth };
+
+// Icosahedron split once (80 faces) and pushed out until its faces clear the
+// unit sphere, as a non-indexed counter-clockwise triangle list
+static vector<vec3> boundingSphereMesh()
+{
+	const float t = (1.0f + std::sqrt(5.0f)) / 2.0f;
+	const vec3 corners[12] = {
+		vec3(-1, t, 0), vec3(1, t, 0), vec3(-1, -t, 0), vec3(1, -t, 0),
+		vec3(0, -1, t), vec3(0, 1, t), vec3(0, -1, -t), vec3(0, 1, -t),
+		vec3(t, 0, -1), vec3(t, 0, 1), vec3(-t, 0, -1), vec3(-t, 0, 1),
+	};
+	const int faces[60] = {
+		0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+		1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+		3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+		4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+	};
+
+	vector<vec3> triangles;
+	for (int f = 0; f < 60; f += 3) {
+		vec3 a = glm::normalize(corners[faces[f]]);
+		vec3 b = glm::normalize(corners[faces[f + 1]]);
+		vec3 c = glm::normalize(corners[faces[f + 2]]);
+		vec3 ab = glm::normalize(a + b);
+		vec3 bc = glm::normalize(b + c);
+		vec3 ca = glm::normalize(c + a);
+		const vec3 split[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+		triangles.insert(triangles.end(), split, split + 12);
+	}
+
+	// Closest face plane to the center sets how far to push out
+	float inradius = 1.0f;
+	for (size_t i = 0; i < triangles.size(); i += 3) {
+		vec3 n = glm::normalize(glm::cross(triangles[i + 1] - triangles[i], triangles[i + 2] - triangles[i]));
+		inradius = std::min(inradius, glm::dot(n, triangles[i]));
+	}
+	for (vec3& v : triangles) v /= inradius;
+	return triangles;
+}
+
+static Program* loadProgram(const std::string& vert, const std::string& frag)
+{
+	Program* program = new Program();
+	program->setVerbose(true);
+	program->setShaderNames(vert, frag);
+	if (!program->init()) {
+		std::cerr << "Deferred shader " << frag << " failed to compile" << std::endl;
+		return nullptr;
+	}
+	return program;
+}
+
+bool DeferredRenderer::init(const std::string& resourceDirectory)
+{
+	geometryProgram = loadProgram(resourceDirectory + "/scene_vert.glsl", resourceDirectory + "/gbuffer_frag.glsl");
+	lightProgram = loadProgram(resourceDirectory + "/light_volume_vert.glsl", resourceDirectory + "/light_volume_frag.glsl");
+	brightsProgram = loadProgram(resourceDirectory + "/fullscreen_vert.glsl", resourceDirectory + "/brights_frag.glsl");
+	if (!geometryProgram || !lightProgram || !brightsProgram) return false;
+
+	geometryProgram->addUniform("P");
+	geometryProgram->addUniform("V");
+	geometryProgram->addUniform("M");
+	geometryProgram->addUniform("globeTexture");
+	geometryProgram->addUniform("isLightSource");
+	geometryProgram->addUniform("isGlobeSphere");
+	geometryProgram->addUniform("numIdleLights");
+	geometryProgram->addUniform("shininess");
+	geometryProgram->addUniform("shapeColor");
+	geometryProgram->addAttribute("vertPos");
+	geometryProgram->addAttribute("vertNor");
+	geometryProgram->addAttribute("vertTex");
+
+	lightProgram->addUniform("P");
+	lightProgram->addUniform("V");
+	lightProgram->addUniform("lightRadius");
+	lightProgram->addUniform("inversePV");
+	lightProgram->addUniform("viewportSize");
+	lightProgram->addUniform("gNormal");
+	lightProgram->addUniform("gAlbedo");
+	lightProgram->addUniform("gDepth");
+	lightProgram->bind();
+	CHECKED_GL_CALL(glUniform1i(lightProgram->getUniform("gNormal"), 0));
+	CHECKED_GL_CALL(glUniform1i(lightProgram->getUniform("gAlbedo"), 1));
+	CHECKED_GL_CALL(glUniform1i(lightProgram->getUniform("gDepth"), 2));
+	lightProgram->unbind();
+
+	brightsProgram->addUniform("scene");
+	brightsProgram->addUniform("gDepth");
+	brightsProgram->bind();
+	CHECKED_GL_CALL(glUniform1i(brightsProgram->getUniform("scene"), 0));
+	CHECKED_GL_CALL(glUniform1i(brightsProgram->getUniform("gDepth"), 2));
+	brightsProgram->unbind();
+
+	// Light volume mesh, with its instance attribute pointed at a buffer on every draw
+	vector<vec3> volume = boundingSphereMesh();
+	volumeVertexCount = (GLsizei) volume.size();
+	CHECKED_GL_CALL(glGenVertexArrays(1, &volumeVAO));
+	CHECKED_GL_CALL(glBindVertexArray(volumeVAO));
+	CHECKED_GL_CALL(glGenBuffers(1, &volumeBufID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, volumeBufID));
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, volume.size() * sizeof(vec3), volume.data(), GL_STATIC_DRAW));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+	CHECKED_GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void*) 0));
+	CHECKED_GL_CALL(glGenBuffers(1, &instanceBufID));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+	CHECKED_GL_CALL(glVertexAttribDivisor(1, 1));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	CHECKED_GL_CALL(glGenVertexArrays(1, &emptyVAO));
+
+	CHECKED_GL_CALL(glGenFramebuffers(1, &gBufferFBO));
+	CHECKED_GL_CALL(glGenFramebuffers(1, &lightFBO));
+	CHECKED_GL_CALL(glGenFramebuffers(1, &brightsFBO));
+	return true;
+}
+
+void DeferredRenderer::setTargets(GLuint sceneColor, GLuint brights, GLuint normal, GLuint albedo, GLuint depth)
+{
+	const GLuint wanted[5] = { sceneColor, brights, normal, albedo, depth };
+	if (std::equal(wanted, wanted + 5, targets)) return;
+	std::copy(wanted, wanted + 5, targets);
+
+	// No pass samples a texture attached to the framebuffer it draws into
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO));
+	for (int i = SceneColor; i <= Albedo; i++) {
+		CHECKED_GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, targets[i], 0));
+	}
+	CHECKED_GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, targets[Depth], 0));
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "G-buffer framebuffer is not completely setup!" << std::endl;
+	}
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, lightFBO));
+	CHECKED_GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[SceneColor], 0));
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, brightsFBO));
+	CHECKED_GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[Brights], 0));
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+}
+
+void DeferredRenderer::beginGeometry()
+{
+	// Brights are written whole by resolve(), so they are neither drawn nor cleared here
+	const GLenum buffers[4] = { GL_COLOR_ATTACHMENT0, GL_NONE, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO));
+	CHECKED_GL_CALL(glDrawBuffers(4, buffers));
+	CHECKED_GL_CALL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
+}
+
+void DeferredRenderer::drawLights(const mat4& P, const mat4& V, const vec4* positions, size_t count, float radius, int width, int height)
+{
+	if (count == 0) return;
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, instanceBufID));
+	// Grow by half again so a slowly growing swarm doesn't reallocate every frame
+	if (count > instanceCapacity) instanceCapacity = count + count / 2;
+	// Orphan last frame's storage instead of waiting for the GPU to finish with it
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(vec4), NULL, GL_STREAM_DRAW));
+	CHECKED_GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(vec4), positions));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	drawVolumes(P, V, instanceBufID, sizeof(vec4), 0, count, radius, width, height);
+}
+
+void DeferredRenderer::drawLightBuffer(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t first, size_t count, float radius, int width, int height)
+{
+	if (count == 0) return;
+	drawVolumes(P, V, buffer, stride, first, count, radius, width, height);
+}
+
+void DeferredRenderer::drawVolumes(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t first, size_t count, float radius, int width, int height)
+{
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, lightFBO));
+	lightProgram->bind();
+	CHECKED_GL_CALL(glUniformMatrix4fv(lightProgram->getUniform("P"), 1, GL_FALSE, value_ptr(P)));
+	CHECKED_GL_CALL(glUniformMatrix4fv(lightProgram->getUniform("V"), 1, GL_FALSE, value_ptr(V)));
+	CHECKED_GL_CALL(glUniformMatrix4fv(lightProgram->getUniform("inversePV"), 1, GL_FALSE, value_ptr(glm::inverse(P * V))));
+	CHECKED_GL_CALL(glUniform2f(lightProgram->getUniform("viewportSize"), (float) width, (float) height));
+	CHECKED_GL_CALL(glUniform1f(lightProgram->getUniform("lightRadius"), radius));
+	bindTexture(GL_TEXTURE0, targets[Normal]);
+	bindTexture(GL_TEXTURE1, targets[Albedo]);
+	bindTexture(GL_TEXTURE2, targets[Depth]);
+
+	CHECKED_GL_CALL(glBindVertexArray(volumeVAO));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+	CHECKED_GL_CALL(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (const void*) (first * stride)));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	// Back faces only, untested, so each covered pixel is shaded once per
+	// light even with the camera inside a volume; lights add up
+	CHECKED_GL_CALL(glDisable(GL_DEPTH_TEST));
+	CHECKED_GL_CALL(glEnable(GL_CULL_FACE));
+	CHECKED_GL_CALL(glCullFace(GL_FRONT));
+	CHECKED_GL_CALL(glEnable(GL_BLEND));
+	CHECKED_GL_CALL(glBlendFunc(GL_ONE, GL_ONE));
+	CHECKED_GL_CALL(glDrawArraysInstanced(GL_TRIANGLES, 0, volumeVertexCount, (GLsizei) count));
+	CHECKED_GL_CALL(glDisable(GL_BLEND));
+	CHECKED_GL_CALL(glCullFace(GL_BACK));
+	CHECKED_GL_CALL(glDisable(GL_CULL_FACE));
+	CHECKED_GL_CALL(glEnable(GL_DEPTH_TEST));
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	lightProgram->unbind();
+	// The G-buffer is drawn into next frame, so nothing of it stays bound for sampling
+	bindTexture(GL_TEXTURE2, 0);
+	bindTexture(GL_TEXTURE1, 0);
+	bindTexture(GL_TEXTURE0, 0);
+}
+
+void DeferredRenderer::resolve()
+{
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, brightsFBO));
+	brightsProgram->bind();
+	bindTexture(GL_TEXTURE0, targets[SceneColor]);
+	bindTexture(GL_TEXTURE2, targets[Depth]);
+	CHECKED_GL_CALL(glDisable(GL_DEPTH_TEST));
+	CHECKED_GL_CALL(glBindVertexArray(emptyVAO));
+	CHECKED_GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glEnable(GL_DEPTH_TEST));
+	brightsProgram->unbind();
+	bindTexture(GL_TEXTURE2, 0);
+	bindTexture(GL_TEXTURE0, 0);
+
+	// Overlays write the scene and brights against the G-buffer depth
+	const GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO));
+	CHECKED_GL_CALL(glDrawBuffers(2, buffers));
+}
+
+void DeferredRenderer::bindTexture(GLenum unit, GLuint texture)
+{
+	CHECKED_GL_CALL(glActiveTexture(unit));
+	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, texture));
+}
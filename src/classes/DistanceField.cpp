@@ -0,0 +1,346 @@
+#include "../headers/DistanceField.h"
+#include "../headers/ThreadPool.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+static const char DistanceFieldMagic[4] = { 'P', 'I', 'O', 'S' };
+static const uint32_t DistanceFieldVersion = 1;
+
+namespace
+{
+	struct Triangle
+	{
+		vec3 a, b, c;
+		vec3 normal;
+		vec3 low, high;
+	};
+
+	// Closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+	vec3 closestPointOnTriangle(const vec3& p, const vec3& a, const vec3& b, const vec3& c)
+	{
+		vec3 ab = b - a, ac = c - a, ap = p - a;
+		float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+		vec3 bp = p - b;
+		float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3) return b;
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + (d1 / (d1 - d3)) * ab;
+
+		vec3 cp = p - c;
+		float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6) return c;
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + (d2 / (d2 - d6)) * ac;
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+
+		float denominator = 1.0f / (va + vb + vc);
+		return a + ab * (vb * denominator) + ac * (vc * denominator);
+	}
+
+	// FNV-1a of the mesh file, so an edited OBJ invalidates its cache
+	bool hashFile(const std::string& path, uint64_t& hash)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file.is_open()) return false;
+		hash = 0xcbf29ce484222325ULL;
+		char buffer[65536];
+		while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0) {
+			for (std::streamsize i = 0; i < file.gcount(); i++) {
+				hash = (hash ^ (unsigned char) buffer[i]) * 0x100000001b3ULL;
+			}
+		}
+		return true;
+	}
+}
+
+void SignedDistanceField::bake(const vector<const Shape*>& shapes, int resolution, int bandCells)
+{
+	this->resolution = resolution;
+	this->bandCells = bandCells;
+
+	vector<Triangle> triangles;
+	vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (const Shape* shape : shapes) {
+		const vector<float>& positions = shape->getPositions();
+		const vector<unsigned int>& indices = shape->getIndices();
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			Triangle t;
+			t.a = vec3(positions[3 * indices[i]], positions[3 * indices[i] + 1], positions[3 * indices[i] + 2]);
+			t.b = vec3(positions[3 * indices[i + 1]], positions[3 * indices[i + 1] + 1], positions[3 * indices[i + 1] + 2]);
+			t.c = vec3(positions[3 * indices[i + 2]], positions[3 * indices[i + 2] + 1], positions[3 * indices[i + 2] + 2]);
+			vec3 n = glm::cross(t.b - t.a, t.c - t.a);
+			float area = glm::length(n);
+			if (area <= 0.0f) continue;
+			t.normal = n / area;
+			t.low = glm::min(glm::min(t.a, t.b), t.c);
+			t.high = glm::max(glm::max(t.a, t.b), t.c);
+			low = glm::min(low, t.low);
+			high = glm::max(high, t.high);
+			triangles.push_back(t);
+		}
+	}
+	brickTable.clear();
+	samples.clear();
+	if (triangles.empty()) return;
+
+	// Pad by the band so the field closes around the mesh
+	vec3 extent = high - low;
+	cellSize = std::max(extent.x, std::max(extent.y, extent.z)) / resolution;
+	float band = bandCells * cellSize;
+	origin = low - vec3(band + cellSize);
+	for (int a = 0; a < 3; a++) {
+		int cells = (int) std::ceil((extent[a] + 2.0f * (band + cellSize)) / cellSize);
+		bricks[a] = (cells + BrickCells - 1) / BrickCells;
+	}
+	size_t brickCount = (size_t) bricks[0] * bricks[1] * bricks[2];
+
+	// Each brick is baked on its own into a scratch slot, then the
+	// non-empty ones are packed in brick order
+	vector<vector<Sample> > baked(brickCount);
+	ThreadPool::shared().parallelFor(brickCount, 1, [&](size_t first, size_t last) {
+		vector<const Triangle*> nearby;
+		for (size_t b = first; b < last; b++) {
+			int bx = (int) (b % bricks[0]);
+			int by = (int) ((b / bricks[0]) % bricks[1]);
+			int bz = (int) (b / ((size_t) bricks[0] * bricks[1]));
+			vec3 brickLow = origin + vec3(bx, by, bz) * (float) BrickCells * cellSize;
+			vec3 brickHigh = brickLow + vec3((float) BrickCells * cellSize);
+
+			// Only triangles that can be within the band of this brick matter
+			nearby.clear();
+			for (const Triangle& t : triangles) {
+				if (t.high.x < brickLow.x - band || t.low.x > brickHigh.x + band) continue;
+				if (t.high.y < brickLow.y - band || t.low.y > brickHigh.y + band) continue;
+				if (t.high.z < brickLow.z - band || t.low.z > brickHigh.z + band) continue;
+				nearby.push_back(&t);
+			}
+			if (nearby.empty()) continue;
+
+			vector<Sample>& out = baked[b];
+			out.resize(SamplesPerBrick);
+			bool inBand = false;
+			for (int z = 0; z < BrickSamples; z++) {
+				for (int y = 0; y < BrickSamples; y++) {
+					for (int x = 0; x < BrickSamples; x++) {
+						vec3 p = brickLow + vec3(x, y, z) * cellSize;
+
+						// Nearest triangle; on ties (edges, corners) the one facing p most
+						// squarely decides the sign
+						float best = FLT_MAX, bestAlignment = -1.0f;
+						vec3 bestOffset(0), bestNormal(0, 1, 0);
+						for (const Triangle* t : nearby) {
+							vec3 offset = p - closestPointOnTriangle(p, t->a, t->b, t->c);
+							float distance = glm::length(offset);
+							if (distance > best + 1e-6f) continue;
+							float alignment = distance > 0.0f ? std::abs(glm::dot(offset, t->normal)) / distance : 1.0f;
+							if (distance < best - 1e-6f || alignment > bestAlignment) {
+								best = std::min(best, distance);
+								bestAlignment = alignment;
+								bestOffset = offset;
+								bestNormal = t->normal;
+							}
+						}
+
+						float sign = glm::dot(bestOffset, bestNormal) >= 0.0f ? 1.0f : -1.0f;
+						Sample& s = out[(z * BrickSamples + y) * BrickSamples + x];
+						s.distance = sign * std::min(best, band);
+						s.gradient = best > 1e-6f ? sign * bestOffset / best : bestNormal;
+						if (best < band) inBand = true;
+					}
+				}
+			}
+			if (!inBand) out.clear();
+		}
+	});
+
+	brickTable.assign(brickCount, -1);
+	int32_t stored = 0;
+	for (size_t b = 0; b < brickCount; b++) {
+		if (baked[b].empty()) continue;
+		brickTable[b] = stored++;
+		samples.insert(samples.end(), baked[b].begin(), baked[b].end());
+	}
+}
+
+bool SignedDistanceField::sample(const vec3& position, float& distance, vec3& gradient) const
+{
+	if (brickTable.empty()) return false;
+
+	vec3 g = (position - origin) / cellSize;
+	if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f) return false;
+	int cx = (int) g.x, cy = (int) g.y, cz = (int) g.z;
+	int bx = cx / BrickCells, by = cy / BrickCells, bz = cz / BrickCells;
+	if (bx >= bricks[0] || by >= bricks[1] || bz >= bricks[2]) return false;
+
+	int32_t brick = brickTable[(bz * bricks[1] + by) * bricks[0] + bx];
+	if (brick < 0) return false;
+
+	int lx = cx - bx * BrickCells, ly = cy - by * BrickCells, lz = cz - bz * BrickCells;
+	vec3 f = g - vec3(cx, cy, cz);
+	const Sample* s = &samples[(size_t) brick * SamplesPerBrick + (lz * BrickSamples + ly) * BrickSamples + lx];
+	const int dy = BrickSamples, dz = BrickSamples * BrickSamples;
+
+	const Sample* corners[8] = { s, s + 1, s + dy, s + dy + 1, s + dz, s + dz + 1, s + dz + dy, s + dz + dy + 1 };
+	float weights[8] = {
+		(1 - f.x) * (1 - f.y) * (1 - f.z), f.x * (1 - f.y) * (1 - f.z),
+		(1 - f.x) * f.y * (1 - f.z), f.x * f.y * (1 - f.z),
+		(1 - f.x) * (1 - f.y) * f.z, f.x * (1 - f.y) * f.z,
+		(1 - f.x) * f.y * f.z, f.x * f.y * f.z
+	};
+	distance = 0.0f;
+	gradient = vec3(0);
+	for (int c = 0; c < 8; c++) {
+		distance += weights[c] * corners[c]->distance;
+		gradient += weights[c] * corners[c]->gradient;
+	}
+	float length = glm::length(gradient);
+	if (length > 0.0f) gradient /= length;
+	return true;
+}
+
+bool SignedDistanceField::loadOrBake(const std::string& objPath, const vector<const Shape*>& shapes, int resolution, int bandCells)
+{
+	uint64_t sourceHash = 0;
+	if (!hashFile(objPath, sourceHash)) {
+		std::cerr << "Could not read mesh for distance field: '" << objPath << "'" << std::endl;
+		return false;
+	}
+
+	std::string cachePath = objPath + ".sdf";
+	if (load(cachePath, sourceHash, resolution, bandCells)) return true;
+
+	bake(shapes, resolution, bandCells);
+	if (!save(cachePath, sourceHash)) {
+		std::cerr << "Could not cache distance field at '" << cachePath << "'" << std::endl;
+	}
+	return !brickTable.empty();
+}
+
+bool SignedDistanceField::load(const std::string& path, uint64_t sourceHash, int resolution, int bandCells)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) return false;
+	uint64_t fileSize = (uint64_t) file.tellg();
+	file.seekg(0);
+
+	char magic[4];
+	uint32_t version = 0;
+	uint64_t hash = 0;
+	int32_t storedResolution = 0, storedBand = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*) &version, sizeof(version));
+	file.read((char*) &hash, sizeof(hash));
+	file.read((char*) &storedResolution, sizeof(storedResolution));
+	file.read((char*) &storedBand, sizeof(storedBand));
+	// Stale or foreign caches are rebaked rather than reported
+	if (!file || std::string(magic, 4) != std::string(DistanceFieldMagic, 4) || version != DistanceFieldVersion ||
+		hash != sourceHash || storedResolution != resolution || storedBand != bandCells) {
+		return false;
+	}
+
+	file.read((char*) &origin, sizeof(origin));
+	file.read((char*) &cellSize, sizeof(cellSize));
+	file.read((char*) bricks, sizeof(bricks));
+	// A bake spans at most resolution cells plus the band and a cell of padding
+	// on each side (and one for rounding) along any axis
+	int maxBricks = (resolution + 2 * bandCells + 3 + BrickCells - 1) / BrickCells;
+	bool valid = file && cellSize > 0.0f && cellSize <= FLT_MAX;
+	for (int a = 0; a < 3; a++) valid = valid && bricks[a] > 0 && bricks[a] <= maxBricks;
+	if (!valid) {
+		std::cerr << "'" << path << "' has a corrupt header, rebaking" << std::endl;
+		return false;
+	}
+	size_t brickCount = (size_t) bricks[0] * bricks[1] * bricks[2];
+	brickTable.resize(brickCount);
+	file.read((char*) brickTable.data(), brickCount * sizeof(int32_t));
+
+	// Bakes pack non-empty bricks in brick order, so offsets count up from 0
+	int32_t stored = 0;
+	for (int32_t b : brickTable) {
+		if (b == stored) stored++;
+		else if (b != -1) valid = false;
+	}
+	uint64_t payload = (uint64_t) file.tellg() + (uint64_t) stored * SamplesPerBrick * sizeof(Sample);
+	if (!file || !valid || payload != fileSize) {
+		std::cerr << "'" << path << "' has a corrupt brick table, rebaking" << std::endl;
+		brickTable.clear();
+		return false;
+	}
+	samples.resize((size_t) stored * SamplesPerBrick);
+	file.read((char*) samples.data(), samples.size() * sizeof(Sample));
+	if (!file) {
+		brickTable.clear();
+		samples.clear();
+		return false;
+	}
+
+	this->resolution = resolution;
+	this->bandCells = bandCells;
+	return true;
+}
+
+bool SignedDistanceField::save(const std::string& path, uint64_t sourceHash) const
+{
+	// Write beside the target and rename, like checkpoints
+	std::string tempPath = path + ".tmp";
+	std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) return false;
+
+	int32_t storedResolution = resolution, storedBand = bandCells;
+	file.write(DistanceFieldMagic, sizeof(DistanceFieldMagic));
+	file.write((const char*) &DistanceFieldVersion, sizeof(DistanceFieldVersion));
+	file.write((const char*) &sourceHash, sizeof(sourceHash));
+	file.write((const char*) &storedResolution, sizeof(storedResolution));
+	file.write((const char*) &storedBand, sizeof(storedBand));
+	file.write((const char*) &origin, sizeof(origin));
+	file.write((const char*) &cellSize, sizeof(cellSize));
+	file.write((const char*) bricks, sizeof(bricks));
+	file.write((const char*) brickTable.data(), brickTable.size() * sizeof(int32_t));
+	file.write((const char*) samples.data(), samples.size() * sizeof(Sample));
+	file.close();
+	if (!file) return false;
+
+	std::remove(path.c_str());
+	return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+void DistanceFieldCollider::setTransform(const mat4& model, float uniformScale)
+{
+	this->model = model;
+	inverse = glm::inverse(model);
+	scale = uniformScale;
+}
+
+void DistanceFieldCollider::collide(const vector<Particle*>& particles, float restitution, float friction, float skin) const
+{
+	if (!field) return;
+	ThreadPool::shared().parallelFor(particles.size(), 256, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++) {
+			Particle* p = particles[i];
+			float distance;
+			vec3 gradient;
+			if (!field->sample(vec3(inverse * glm::vec4(p->position, 1.0f)), distance, gradient)) continue;
+			distance *= scale;
+			if (distance >= skin) continue;
+
+			vec3 normal = glm::normalize(vec3(model * glm::vec4(gradient, 0.0f)));
+			p->position += (skin - distance) * normal;
+			float along = glm::dot(p->velocity, normal);
+			if (along < 0.0f) {
+				vec3 tangent = p->velocity - along * normal;
+				p->velocity = (1.0f - friction) * tangent - restitution * along * normal;
+			}
+		}
+	});
+}
@@ -0,0 +1,39 @@
+#include "../headers/DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+bool DynamicResolution::addSample(double gpuMs, float issuedScale)
+{
+	// Timing from another scale says nothing about this one
+	if (issuedScale != getScale()) return false;
+
+	average = samples == 0 ? gpuMs : average + smoothing * (gpuMs - average);
+	samples++;
+
+	if (average > targetMs * overBudget) {
+		overFrames++;
+		underFrames = 0;
+	}
+	else if (average < targetMs * underBudget) {
+		underFrames++;
+		overFrames = 0;
+	}
+	else {
+		overFrames = underFrames = 0;
+	}
+	if (overFrames < dropAfterFrames && underFrames < raiseAfterFrames) return false;
+	overFrames = underFrames = 0;
+
+	// Aim for the middle of the band
+	double aim = targetMs * (overBudget + underBudget) * 0.5;
+	float current = getScale();
+	float wanted = current * (float) std::sqrt(aim / std::max(average, 1e-3));
+	wanted = std::round(wanted / step) * step;
+	wanted = std::min(std::max(wanted, minScale), maxScale);
+	if (std::fabs(wanted - current) < step * 0.5f) return false;
+
+	// Measure afresh at the new scale
+	scale = wanted;
+	samples = 0;
+	return true;
+}
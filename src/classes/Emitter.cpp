@@ -0,0 +1,136 @@
+#include "../headers/Emitter.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+Emitter Emitter::point(const vec3& position)
+{
+	Emitter e;
+	e.kind = Point;
+	e.center = position;
+	return e;
+}
+
+Emitter Emitter::sphere(const vec3& center, float radius)
+{
+	Emitter e;
+	e.kind = Sphere;
+	e.center = center;
+	e.radius = radius;
+	return e;
+}
+
+Emitter Emitter::meshSurface(const vector<const Shape*>& shapes, const mat4& model)
+{
+	Emitter e;
+	e.kind = MeshSurface;
+	float total = 0.0f;
+	for (const Shape* shape : shapes) {
+		const vector<float>& positions = shape->getPositions();
+		const vector<unsigned int>& indices = shape->getIndices();
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			vec3 v[3];
+			for (int c = 0; c < 3; c++) {
+				unsigned int index = indices[i + c];
+				v[c] = vec3(model * glm::vec4(positions[3 * index], positions[3 * index + 1], positions[3 * index + 2], 1.0f));
+			}
+			float area = 0.5f * glm::length(glm::cross(v[1] - v[0], v[2] - v[0]));
+			if (area <= 0.0f) continue;
+			total += area;
+			e.corners.push_back(v[0]);
+			e.corners.push_back(v[1]);
+			e.corners.push_back(v[2]);
+			e.cumulativeArea.push_back(total);
+		}
+	}
+	return e;
+}
+
+size_t Emitter::emit(float dt, Random& rng, ParticlePool& pool, vector<Particle*>& live)
+{
+	if (!enabled) return 0;
+	carry += rate * dt;
+	size_t count = (size_t) carry;
+	carry -= (float) count;
+	return burst(count, rng, pool, live);
+}
+
+size_t Emitter::burst(size_t count, Random& rng, ParticlePool& pool, vector<Particle*>& live)
+{
+	if (count == 0 || (kind == MeshSurface && cumulativeArea.empty())) return 0;
+
+	draws.resize(count * DrawsPerParticle);
+	rng.fill(draws.data(), draws.size(), 0.0f, 1.0f);
+	live.reserve(live.size() + count);
+	pool.reserve(count);
+
+	const float twoPi = 6.2831853f;
+	for (size_t n = 0; n < count; n++) {
+		const float* u = &draws[n * DrawsPerParticle];
+		vec3 position = center;
+		vec3 direction(0);
+
+		if (kind == Sphere) {
+			// Uniform in the ball: direction from z and angle, radius by cube root
+			float z = 2.0f * u[0] - 1.0f;
+			float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+			float angle = twoPi * u[1];
+			direction = vec3(ring * std::cos(angle), ring * std::sin(angle), z);
+			position = center + direction * (radius * std::cbrt(u[2]));
+		}
+		else if (kind == MeshSurface) {
+			float target = u[0] * cumulativeArea.back();
+			size_t tri = std::lower_bound(cumulativeArea.begin(), cumulativeArea.end(), target) - cumulativeArea.begin();
+			tri = std::min(tri, cumulativeArea.size() - 1);
+			const vec3* v = &corners[3 * tri];
+			// Uniform barycentric point
+			float s = std::sqrt(u[1]);
+			position = v[0] * (1.0f - s) + v[1] * (s * (1.0f - u[2])) + v[2] * (s * u[2]);
+			direction = glm::normalize(glm::cross(v[1] - v[0], v[2] - v[0]));
+		}
+		else {
+			direction = glm::normalize(vec3(u[0], u[1], u[2]) - vec3(0.5f) + vec3(1e-6f));
+		}
+
+		vec3 velocity = speed * direction + jitter * (2.0f * vec3(u[3], u[4], u[5]) - vec3(1.0f));
+		Particle* p = pool.acquire(minMass + (maxMass - minMass) * u[6], position, velocity);
+		p->lifetime = minLifetime + (maxLifetime - minLifetime) * u[7];
+		live.push_back(p);
+	}
+	return count;
+}
+
+void benchmarkEmitters(float rate, float lifetime, int steps)
+{
+	const float dt = 1.0f / 60.0f;
+	ParticlePool pool;
+	vector<Particle*> live;
+	Random rng(7);
+	Emitter emitter = Emitter::sphere(vec3(0), 1.0f);
+	emitter.rate = rate;
+	emitter.minLifetime = emitter.maxLifetime = lifetime;
+
+	// Warm up until births and deaths balance, then time the steady state
+	int warmup = (int) std::ceil(lifetime / dt) + 1;
+	size_t spawned = 0, killed = 0, capacity = 0;
+	double elapsed = 0.0;
+	for (int s = 0; s < warmup + steps; s++) {
+		if (s == warmup) capacity = pool.getCapacity();
+		auto start = std::chrono::high_resolution_clock::now();
+
+		size_t born = emitter.emit(dt, rng, pool, live);
+		for (Particle* p : live) p->age += dt;
+		size_t died = pool.releaseIf(live, [](const Particle* p) { return p->lifetime > 0.0f && p->age >= p->lifetime; });
+
+		if (s >= warmup) {
+			elapsed += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			spawned += born;
+			killed += died;
+		}
+	}
+
+	printf("Emitters: %.3g spawns/s simulated, %.2f s lifetime, %zu live\n", rate, lifetime, live.size());
+	printf("  %.3g spawns/s and %.3g kills/s of wall time (%.2f ms per step)\n", spawned / elapsed, killed / elapsed, 1e3 * elapsed / steps);
+	printf("  pool grew by %zu particles in the steady state\n", pool.getCapacity() - capacity);
+}
@@ -0,0 +1,223 @@
+#include "../headers/Flocking.h"
+#include "../headers/Random.h"
+#include "../headers/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLOCKING_USE_SSE2
+#endif
+
+namespace
+{
+	// Running sums for one boid: neighbour count, position, velocity, separation
+	struct Neighborhood
+	{
+		int count = 0;
+		float sums[9] = { 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+#ifdef FLOCKING_USE_SSE2
+		__m128 lanes[9];
+		Neighborhood()
+		{
+			for (int s = 0; s < 9; s++) lanes[s] = _mm_setzero_ps();
+		}
+#endif
+
+		// Lane sums folded into sums
+		void finish()
+		{
+#ifdef FLOCKING_USE_SSE2
+			for (int s = 0; s < 9; s++) {
+				float lane[4];
+				_mm_storeu_ps(lane, lanes[s]);
+				sums[s] += (lane[0] + lane[1]) + (lane[2] + lane[3]);
+			}
+#endif
+		}
+	};
+
+	struct Columns
+	{
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* vx;
+		const float* vy;
+		const float* vz;
+	};
+
+	// Adds the boids of sorted range [begin, end) that lie within radius of p
+	void accumulateRange(const Columns& c, size_t begin, size_t end, const vec3& p, float radius2, float separation2, Neighborhood& n)
+	{
+		size_t j = begin;
+#ifdef FLOCKING_USE_SSE2
+		const __m128 px = _mm_set1_ps(p.x), py = _mm_set1_ps(p.y), pz = _mm_set1_ps(p.z);
+		const __m128 r2 = _mm_set1_ps(radius2), s2 = _mm_set1_ps(separation2);
+		const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), tiny = _mm_set1_ps(1e-6f);
+		for (; j + 4 <= end; j += 4) {
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(c.x + j), px);
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(c.y + j), py);
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(c.z + j), pz);
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			// Distance zero is the boid itself (or one on top of it)
+			__m128 notSelf = _mm_cmpgt_ps(d2, zero);
+			__m128 in = _mm_and_ps(_mm_cmplt_ps(d2, r2), notSelf);
+			int mask = _mm_movemask_ps(in);
+			if (mask == 0) continue;
+			n.count += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + ((mask >> 3) & 1);
+
+			n.lanes[0] = _mm_add_ps(n.lanes[0], _mm_and_ps(in, dx));
+			n.lanes[1] = _mm_add_ps(n.lanes[1], _mm_and_ps(in, dy));
+			n.lanes[2] = _mm_add_ps(n.lanes[2], _mm_and_ps(in, dz));
+			n.lanes[3] = _mm_add_ps(n.lanes[3], _mm_and_ps(in, _mm_loadu_ps(c.vx + j)));
+			n.lanes[4] = _mm_add_ps(n.lanes[4], _mm_and_ps(in, _mm_loadu_ps(c.vy + j)));
+			n.lanes[5] = _mm_add_ps(n.lanes[5], _mm_and_ps(in, _mm_loadu_ps(c.vz + j)));
+
+			__m128 near = _mm_and_ps(_mm_cmplt_ps(d2, s2), notSelf);
+			__m128 weight = _mm_and_ps(near, _mm_div_ps(one, _mm_max_ps(d2, tiny)));
+			n.lanes[6] = _mm_sub_ps(n.lanes[6], _mm_mul_ps(dx, weight));
+			n.lanes[7] = _mm_sub_ps(n.lanes[7], _mm_mul_ps(dy, weight));
+			n.lanes[8] = _mm_sub_ps(n.lanes[8], _mm_mul_ps(dz, weight));
+		}
+#endif
+		for (; j < end; j++) {
+			float dx = c.x[j] - p.x, dy = c.y[j] - p.y, dz = c.z[j] - p.z;
+			float d2 = dx * dx + dy * dy + dz * dz;
+			if (d2 >= radius2 || d2 <= 0.0f) continue;
+			n.count++;
+			n.sums[0] += dx;
+			n.sums[1] += dy;
+			n.sums[2] += dz;
+			n.sums[3] += c.vx[j];
+			n.sums[4] += c.vy[j];
+			n.sums[5] += c.vz[j];
+			if (d2 < separation2) {
+				float weight = 1.0f / std::max(d2, 1e-6f);
+				n.sums[6] -= dx * weight;
+				n.sums[7] -= dy * weight;
+				n.sums[8] -= dz * weight;
+			}
+		}
+	}
+}
+
+void Flocking::compute(const vector<Particle*>& boids, vector<vec3>& forces)
+{
+	positions.resize(boids.size());
+	velocities.resize(boids.size());
+	for (size_t i = 0; i < boids.size(); i++) {
+		positions[i] = boids[i]->position;
+		velocities[i] = boids[i]->velocity;
+	}
+	compute(positions, velocities, forces);
+}
+
+void Flocking::compute(const vector<vec3>& positions, const vector<vec3>& velocities, vector<vec3>& forces)
+{
+	size_t count = positions.size();
+	forces.resize(count);
+	candidateTests = 0;
+	if (count == 0) return;
+
+	grid.build(positions.data(), count, params.radius);
+	vx.resize(count);
+	vy.resize(count);
+	vz.resize(count);
+	for (size_t k = 0; k < count; k++) {
+		const vec3& v = velocities[grid.order[k]];
+		vx[k] = v.x;
+		vy[k] = v.y;
+		vz[k] = v.z;
+	}
+
+	const Columns columns = { grid.x.data(), grid.y.data(), grid.z.data(), vx.data(), vy.data(), vz.data() };
+	const size_t cells = grid.getCellCount();
+	const float radius2 = params.radius * params.radius;
+	const float separation2 = params.separationRadius * params.separationRadius;
+	const size_t cap = (size_t) std::max(params.maxNeighbors, 1);
+	std::atomic<uint64_t> tests(0);
+
+	ThreadPool& pool = ThreadPool::shared();
+	size_t grain = std::max<size_t>(16, cells / (pool.size() * 16));
+	pool.parallelFor(cells, grain, [&](size_t first, size_t last) {
+		uint64_t localTests = 0;
+		size_t rangeBegin[27], rangeEnd[27];
+		for (size_t c = first; c < last; c++) {
+			if (grid.cellStart[c] == grid.cellStart[c + 1]) continue;
+
+			// Candidate ranges of the 3x3x3 block, own cell first (plus one for the boid itself), each capped
+			int ranges = grid.neighborRanges(c, rangeBegin, rangeEnd);
+			for (int r = 0; r < ranges; r++) {
+				rangeEnd[r] = std::min(rangeEnd[r], rangeBegin[r] + cap + (r == 0 ? 1 : 0));
+			}
+
+			for (size_t k = grid.cellStart[c]; k < grid.cellStart[c + 1]; k++) {
+				vec3 p(columns.x[k], columns.y[k], columns.z[k]);
+				Neighborhood n;
+				for (int r = 0; r < ranges && (size_t) n.count < cap; r++) {
+					accumulateRange(columns, rangeBegin[r], rangeEnd[r], p, radius2, separation2, n);
+					localTests += rangeEnd[r] - rangeBegin[r];
+				}
+				n.finish();
+
+				vec3 steer(0);
+				if (n.count > 0) {
+					float inverse = 1.0f / n.count;
+					vec3 v(columns.vx[k], columns.vy[k], columns.vz[k]);
+					vec3 towardsCenter = vec3(n.sums[0], n.sums[1], n.sums[2]) * inverse;
+					vec3 averageVelocity = vec3(n.sums[3], n.sums[4], n.sums[5]) * inverse;
+					steer = params.separation * vec3(n.sums[6], n.sums[7], n.sums[8])
+						+ params.alignment * (averageVelocity - v)
+						+ params.cohesion * towardsCenter;
+					float length = glm::length(steer);
+					if (length > params.maxForce) steer *= params.maxForce / length;
+				}
+				forces[grid.order[k]] = steer;
+			}
+		}
+		tests += localTests;
+	});
+	candidateTests = tests;
+}
+
+void benchmarkFlocking(size_t count, int steps)
+{
+	Flocking flocking;
+	const FlockingParams& params = flocking.params;
+
+	// Cube sized for about ten boids per neighbourhood
+	float neighborhood = 4.18879f * params.radius * params.radius * params.radius;
+	float side = std::cbrt(count * neighborhood / 10.0f);
+
+	Random rng(2024);
+	vector<vec3> positions(count), velocities(count), forces;
+	for (size_t i = 0; i < count; i++) {
+		positions[i] = vec3(rng.nextFloat(0.0f, side), rng.nextFloat(0.0f, side), rng.nextFloat(0.0f, side));
+		velocities[i] = vec3(rng.nextFloat(-0.5f, 0.5f), rng.nextFloat(-0.5f, 0.5f), rng.nextFloat(-0.5f, 0.5f));
+	}
+
+	const float dt = 1.0f / 60.0f;
+	double elapsed = 0.0;
+	uint64_t tests = 0;
+	for (int s = 0; s < steps; s++) {
+		auto start = std::chrono::high_resolution_clock::now();
+		flocking.compute(positions, velocities, forces);
+		elapsed += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		tests += flocking.getCandidateTests();
+
+		for (size_t i = 0; i < count; i++) {
+			velocities[i] += forces[i] * dt;
+			positions[i] += velocities[i] * dt;
+		}
+	}
+
+	double perStep = elapsed / steps;
+	printf("Flocking: %zu boids, %d steps, %u threads\n", count, steps, ThreadPool::shared().size());
+	printf("  %.2f ms per step (%.0f Hz)\n", 1e3 * perStep, 1.0 / perStep);
+	printf("  %.3g neighbour queries/s, %.3g candidate tests/s\n", count / perStep, tests / elapsed);
+}
@@ -0,0 +1,194 @@
+#include "../headers/FlowField.h"
+#include <cmath>
+
+namespace
+{
+	// Integer hash (lowbias32)
+	inline uint32_t hash(uint32_t x)
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352du;
+		x ^= x >> 15;
+		x *= 0x846ca68bu;
+		x ^= x >> 16;
+		return x;
+	}
+
+	// One of the 12 cube edge directions, dotted with the offset
+	inline float gradientDot(uint32_t h, float x, float y, float z)
+	{
+		switch (h % 12) {
+			case 0: return x + y;
+			case 1: return -x + y;
+			case 2: return x - y;
+			case 3: return -x - y;
+			case 4: return x + z;
+			case 5: return -x + z;
+			case 6: return x - z;
+			case 7: return -x - z;
+			case 8: return y + z;
+			case 9: return -y + z;
+			case 10: return y - z;
+			default: return -y - z;
+		}
+	}
+
+	inline float fade(float t)
+	{
+		return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+	}
+
+	// Perlin gradient noise, roughly in [-1, 1]
+	float gradientNoise(vec3 q, uint32_t seed)
+	{
+		float fx = std::floor(q.x), fy = std::floor(q.y), fz = std::floor(q.z);
+		uint32_t ix = (uint32_t) (int32_t) fx, iy = (uint32_t) (int32_t) fy, iz = (uint32_t) (int32_t) fz;
+		float x = q.x - fx, y = q.y - fy, z = q.z - fz;
+
+		float corners[8];
+		for (int c = 0; c < 8; c++) {
+			uint32_t cx = c & 1, cy = (c >> 1) & 1, cz = c >> 2;
+			uint32_t h = hash(((ix + cx) * 0x8da6b343u) ^ ((iy + cy) * 0xd8163841u) ^ ((iz + cz) * 0xcb1ab31fu) ^ seed);
+			corners[c] = gradientDot(h, x - cx, y - cy, z - cz);
+		}
+
+		float u = fade(x), v = fade(y), w = fade(z);
+		float x00 = corners[0] + u * (corners[1] - corners[0]);
+		float x10 = corners[2] + u * (corners[3] - corners[2]);
+		float x01 = corners[4] + u * (corners[5] - corners[4]);
+		float x11 = corners[6] + u * (corners[7] - corners[6]);
+		float y0 = x00 + v * (x10 - x00);
+		float y1 = x01 + v * (x11 - x01);
+		return y0 + w * (y1 - y0);
+	}
+
+	// Vector potential: three decorrelated noise channels
+	inline vec3 potential(vec3 q, uint32_t seed)
+	{
+		return vec3(gradientNoise(q, seed),
+			gradientNoise(q + vec3(31.416f, -47.853f, 12.679f), seed),
+			gradientNoise(q + vec3(-23.191f, 18.032f, 59.714f), seed));
+	}
+}
+
+CurlNoiseGrid::~CurlNoiseGrid()
+{
+	shutdown();
+}
+
+void CurlNoiseGrid::init(vec3 center, float halfExtent, int resolution, uint32_t seed)
+{
+	shutdown();
+
+	this->resolution = resolution;
+	this->seed = seed;
+	origin = center - vec3(halfExtent);
+	spacing = 2.0f * halfExtent / (resolution - 1);
+	inverseSpacing = 1.0f / spacing;
+
+	size_t cells = (size_t) resolution * resolution * resolution;
+	current.resize(cells);
+	next.resize(cells);
+	for (int z = 0; z < resolution; z++) bakeSlab(0, z, current);
+	currentGeneration = 0;
+
+	stopping = false;
+	nextReady = false;
+	requested = 1;
+	worker = std::thread(&CurlNoiseGrid::builderLoop, this);
+}
+
+void CurlNoiseGrid::advance(uint32_t step)
+{
+	uint32_t generation = step / refreshInterval;
+	if (generation == currentGeneration) return;
+	if (generation != currentGeneration + 1) {
+		reset(step);
+		return;
+	}
+
+	// Normally long finished; only blocks if the builder fell behind
+	std::unique_lock<std::mutex> guard(lock);
+	changed.wait(guard, [this] { return nextReady; });
+	current.swap(next);
+	currentGeneration = generation;
+	nextReady = false;
+	requested = generation + 1;
+	changed.notify_all();
+}
+
+void CurlNoiseGrid::reset(uint32_t step)
+{
+	currentGeneration = step / refreshInterval;
+	for (int z = 0; z < resolution; z++) bakeSlab(currentGeneration, z, current);
+	requestGeneration(currentGeneration + 1);
+}
+
+void CurlNoiseGrid::shutdown()
+{
+	if (!worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	changed.notify_all();
+	worker.join();
+}
+
+void CurlNoiseGrid::requestGeneration(uint32_t generation)
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		requested = generation;
+		nextReady = false;
+	}
+	changed.notify_all();
+}
+
+void CurlNoiseGrid::builderLoop()
+{
+	std::unique_lock<std::mutex> guard(lock);
+	while (!stopping) {
+		if (nextReady) {
+			changed.wait(guard);
+			continue;
+		}
+
+		// One slab at a time, dropping the bake if a different generation is wanted
+		uint32_t generation = requested;
+		bool finished = true;
+		guard.unlock();
+		for (int z = 0; z < resolution && finished; z++) {
+			bakeSlab(generation, z, next);
+			std::lock_guard<std::mutex> check(lock);
+			finished = !stopping && requested == generation;
+		}
+		guard.lock();
+
+		if (finished && !stopping && requested == generation) {
+			nextReady = true;
+			changed.notify_all();
+		}
+	}
+}
+
+void CurlNoiseGrid::bakeSlab(uint32_t generation, int z, vector<vec3>& out) const
+{
+	// Central differences in noise space, then back to world units
+	const float e = 0.01f;
+	const float scale = frequency / (2.0f * e);
+	vec3 offset = (float) generation * drift * vec3(1.0f, 0.7f, 0.4f);
+
+	for (int y = 0; y < resolution; y++) {
+		for (int x = 0; x < resolution; x++) {
+			vec3 q = (origin + vec3(x, y, z) * spacing) * frequency + offset;
+
+			vec3 dx = potential(q + vec3(e, 0, 0), seed) - potential(q - vec3(e, 0, 0), seed);
+			vec3 dy = potential(q + vec3(0, e, 0), seed) - potential(q - vec3(0, e, 0), seed);
+			vec3 dz = potential(q + vec3(0, 0, e), seed) - potential(q - vec3(0, 0, e), seed);
+
+			// curl = (dPz/dy - dPy/dz, dPx/dz - dPz/dx, dPy/dx - dPx/dy)
+			out[(z * resolution + y) * resolution + x] = scale * vec3(dy.z - dz.y, dz.x - dx.z, dx.y - dy.x);
+		}
+	}
+}
@@ -0,0 +1,101 @@
+#include "../headers/Fluid.h"
+#include "../headers/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+}
+
+void SphFluid::compute(const vector<Particle*>& particles, vector<vec3>& forces)
+{
+	size_t count = particles.size();
+	forces.resize(count);
+	if (count == 0) return;
+
+	positions.resize(count);
+	for (size_t i = 0; i < count; i++) positions[i] = particles[i]->position;
+	grid.build(positions.data(), count, params.smoothingRadius);
+
+	vx.resize(count);
+	vy.resize(count);
+	vz.resize(count);
+	mass.resize(count);
+	density.resize(count);
+	pressure.resize(count);
+	for (size_t k = 0; k < count; k++) {
+		const Particle* p = particles[grid.order[k]];
+		vx[k] = p->velocity.x;
+		vy[k] = p->velocity.y;
+		vz[k] = p->velocity.z;
+		mass[k] = p->mass;
+	}
+
+	const float h = params.smoothingRadius;
+	const float h2 = h * h;
+	const float poly6 = 315.0f / (64.0f * Pi * std::pow(h, 9.0f));
+	const float spikyGradient = -45.0f / (Pi * std::pow(h, 6.0f));
+	const float viscosityLaplacian = 45.0f / (Pi * std::pow(h, 6.0f));
+
+	ThreadPool& pool = ThreadPool::shared();
+	const size_t cells = grid.getCellCount();
+	const size_t grain = std::max<size_t>(16, cells / (pool.size() * 16));
+	const float* x = grid.x.data();
+	const float* y = grid.y.data();
+	const float* z = grid.z.data();
+
+	// Density and pressure; each cell writes only its own particles
+	pool.parallelFor(cells, grain, [&](size_t first, size_t last) {
+		size_t rangeBegin[27], rangeEnd[27];
+		for (size_t c = first; c < last; c++) {
+			if (grid.cellStart[c] == grid.cellStart[c + 1]) continue;
+			int ranges = grid.neighborRanges(c, rangeBegin, rangeEnd);
+			for (size_t k = grid.cellStart[c]; k < grid.cellStart[c + 1]; k++) {
+				float rho = 0.0f;
+				for (int r = 0; r < ranges; r++) {
+					for (size_t j = rangeBegin[r]; j < rangeEnd[r]; j++) {
+						float dx = x[j] - x[k], dy = y[j] - y[k], dz = z[j] - z[k];
+						float d2 = dx * dx + dy * dy + dz * dz;
+						float w = std::max(h2 - d2, 0.0f);
+						rho += mass[j] * w * w * w;
+					}
+				}
+				density[k] = poly6 * rho;
+				// Tension is dropped, it only clumps particles at this resolution
+				pressure[k] = std::max(params.stiffness * (density[k] - params.restDensity), 0.0f);
+			}
+		}
+	});
+
+	// Pressure and viscosity, as force = mass / density * force density
+	pool.parallelFor(cells, grain, [&](size_t first, size_t last) {
+		size_t rangeBegin[27], rangeEnd[27];
+		for (size_t c = first; c < last; c++) {
+			if (grid.cellStart[c] == grid.cellStart[c + 1]) continue;
+			int ranges = grid.neighborRanges(c, rangeBegin, rangeEnd);
+			for (size_t k = grid.cellStart[c]; k < grid.cellStart[c + 1]; k++) {
+				vec3 fPressure(0), fViscosity(0);
+				for (int r = 0; r < ranges; r++) {
+					for (size_t j = rangeBegin[r]; j < rangeEnd[r]; j++) {
+						if (j == k) continue;
+						vec3 d(x[k] - x[j], y[k] - y[j], z[k] - z[j]);
+						float d2 = glm::dot(d, d);
+						if (d2 >= h2 || d2 <= 1e-12f) continue;
+
+						float distance = std::sqrt(d2);
+						float falloff = h - distance;
+						// Spiky gradient points from j to k, so subtracting pushes k away
+						vec3 gradient = (spikyGradient * falloff * falloff / distance) * d;
+						fPressure -= (mass[j] * (pressure[k] + pressure[j]) / (2.0f * density[j])) * gradient;
+
+						vec3 relative(vx[j] - vx[k], vy[j] - vy[k], vz[j] - vz[k]);
+						fViscosity += (mass[j] / density[j] * viscosityLaplacian * falloff) * relative;
+					}
+				}
+				forces[grid.order[k]] = mass[k] / density[k] * (fPressure + params.viscosity * fViscosity);
+			}
+		}
+	});
+}
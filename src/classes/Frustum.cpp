@@ -0,0 +1,53 @@
+#include "../headers/Frustum.h"
+#include <cmath>
+
+void Frustum::extract(const mat4& viewProjection)
+{
+	// Rows of the matrix (glm is column major)
+	vec4 row[4];
+	for (int i = 0; i < 4; i++) {
+		row[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	}
+
+	// Left, right, bottom, top, near, far
+	planes[0] = row[3] + row[0];
+	planes[1] = row[3] - row[0];
+	planes[2] = row[3] + row[1];
+	planes[3] = row[3] - row[1];
+	planes[4] = row[3] + row[2];
+	planes[5] = row[3] - row[2];
+
+	// Normalize so plane distances are in world units
+	for (int i = 0; i < 6; i++) {
+		float len = glm::length(vec3(planes[i]));
+		planes[i] = planes[i] / len;
+	}
+}
+
+bool Frustum::containsSphere(const vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++) {
+		if (glm::dot(vec3(planes[i]), center) + planes[i].w < -radius) return false;
+	}
+	return true;
+}
+
+bool Frustum::containsBox(const vec3& min, const vec3& max, const mat4& model) const
+{
+	// World space box around the transformed model box
+	vec3 localCenter = (min + max) * 0.5f;
+	vec3 localExtent = (max - min) * 0.5f;
+	vec3 center = vec3(model * vec4(localCenter, 1.0f));
+	vec3 extent;
+	for (int i = 0; i < 3; i++) {
+		extent[i] = std::fabs(model[0][i]) * localExtent.x + std::fabs(model[1][i]) * localExtent.y + std::fabs(model[2][i]) * localExtent.z;
+	}
+
+	for (int i = 0; i < 6; i++) {
+		vec3 n = vec3(planes[i]);
+		// Projected radius of the box onto the plane normal
+		float r = extent.x * std::fabs(n.x) + extent.y * std::fabs(n.y) + extent.z * std::fabs(n.z);
+		if (glm::dot(n, center) + planes[i].w < -r) return false;
+	}
+	return true;
+}
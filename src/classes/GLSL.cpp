@@ -15,6 +15,9 @@
 namespace GLSL
 {
 
+CallSite lastCallSite = { "(none)", "(none)", 0 };
+bool debugOutputEnabled = false;
+
 const char * errorString(GLenum err)
 {
 	switch (err) {
@@ -47,6 +50,45 @@ void printOpenGLErrors(const char *const Function, const char * const File, int
 	}
 }
 
+const char * debugSeverityString(GLenum severity)
+{
+	switch (severity) {
+	case GL_DEBUG_SEVERITY_HIGH:
+		return "high";
+	case GL_DEBUG_SEVERITY_MEDIUM:
+		return "medium";
+	case GL_DEBUG_SEVERITY_LOW:
+		return "low";
+	default:
+		return "notification";
+	}
+}
+
+void APIENTRY debugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *userParam)
+{
+	// Snapshot the site once; the render thread may overwrite it while we print
+	CallSite site = lastCallSite;
+	printf("OpenGL debug (%s, id %u) near file '%s' at line %d after '%s': %s\n", debugSeverityString(severity), id, site.file, site.line, site.function, message);
+}
+
+bool enableDebugOutput()
+{
+	if (!GLAD_GL_KHR_debug)
+	{
+		printf("KHR_debug not available, falling back to glGetError polling\n");
+		debugOutputEnabled = false;
+		return false;
+	}
+
+	// Leave GL_DEBUG_OUTPUT_SYNCHRONOUS off so the driver never has to stall for us
+	glEnable(GL_DEBUG_OUTPUT);
+	glDebugMessageCallback(debugMessageCallback, NULL);
+	// Notifications are mostly buffer placement chatter, keep only real problems
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+	debugOutputEnabled = true;
+	return true;
+}
+
 void checkError(const char *str)
 {
 	GLenum glErr = glGetError();
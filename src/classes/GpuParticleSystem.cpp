@@ -0,0 +1,213 @@
+#include "../headers/GpuParticleSystem.h"
+#include <algorithm>
+#include <iostream>
+
+#include "../headers/GLSL.h"
+
+GpuParticleSystem::GpuParticleSystem(int capacity) : capacity(capacity)
+{
+	static_assert(sizeof(GpuParticle) == 8 * sizeof(float), "GpuParticle must match the shader layout");
+}
+
+bool GpuParticleSystem::init(const std::string& resourceDirectory, const Shape* mesh)
+{
+	using ::std::cerr;
+	using ::std::endl;
+
+	// Update program, outputs captured back into the other state buffer
+	updateProgram = new Program();
+	updateProgram->setVerbose(true);
+	updateProgram->setShaderNames(resourceDirectory + "/particle_update_vert.glsl", resourceDirectory + "/particle_update_frag.glsl");
+	updateProgram->setTransformFeedbackVaryings({ "outPositionMass", "outVelocitySeed" });
+	if (!updateProgram->init()) {
+		cerr << "Particle update shader failed to compile" << endl;
+		return false;
+	}
+	updateProgram->addUniform("dt");
+	updateProgram->addUniform("frame");
+	updateProgram->addUniform("isGravityOn");
+	updateProgram->addUniform("isCenterPointAttractive");
+	updateProgram->addUniform("centerPoint");
+	updateProgram->addUniform("domainHalfExtent");
+	updateProgram->addUniform("numMagnets");
+	updateProgram->addUniform("magnets");
+
+	// Draw program, lit by the regular scene fragment shader as a light source
+	drawProgram = new Program();
+	drawProgram->setVerbose(true);
+	drawProgram->setShaderNames(resourceDirectory + "/particle_vert.glsl", resourceDirectory + "/scene_frag.glsl");
+	if (!drawProgram->init()) {
+		cerr << "Particle draw shader failed to compile" << endl;
+		return false;
+	}
+	drawProgram->addUniform("P");
+	drawProgram->addUniform("V");
+	drawProgram->addUniform("particleScale");
+	drawProgram->addUniform("isLightSource");
+	drawProgram->addUniform("lightBuffer");
+
+	// Interleaved copy of the mesh: position 3, normal 3, texcoord 2
+	const vector<float>& pos = mesh->getPositions();
+	const vector<float>& nor = mesh->getNormals();
+	const vector<float>& tex = mesh->getTexCoords();
+	vector<float> vertices;
+	for (size_t v = 0; v < pos.size() / 3; v++) {
+		for (int i = 0; i < 3; i++) vertices.push_back(pos[3 * v + i]);
+		for (int i = 0; i < 3; i++) vertices.push_back(nor.empty() ? 0.0f : nor[3 * v + i]);
+		for (int i = 0; i < 2; i++) vertices.push_back(tex.empty() ? 0.0f : tex[2 * v + i]);
+	}
+	meshIndexCount = (GLsizei) mesh->getIndices().size();
+
+	CHECKED_GL_CALL(glGenBuffers(1, &meshBufID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, meshBufID));
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW));
+
+	// State buffers start zeroed (value initialized), i.e. every slot dead
+	vector<GpuParticle> empty(capacity);
+	CHECKED_GL_CALL(glGenBuffers(2, stateBufID));
+	CHECKED_GL_CALL(glGenTextures(2, stateTexID));
+	CHECKED_GL_CALL(glGenVertexArrays(2, updateVaoID));
+	CHECKED_GL_CALL(glGenVertexArrays(2, drawVaoID));
+	CHECKED_GL_CALL(glGenBuffers(1, &meshEleBufID));
+
+	GLsizei stride = sizeof(GpuParticle);
+	GLsizei meshStride = 8 * sizeof(float);
+	for (int i = 0; i < 2; i++) {
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stateBufID[i]));
+		CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, empty.size() * sizeof(GpuParticle), empty.data(), GL_DYNAMIC_COPY));
+
+		// Update pass reads one particle per vertex
+		CHECKED_GL_CALL(glBindVertexArray(updateVaoID[i]));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+		CHECKED_GL_CALL(glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, stride, (const void*) 0));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+		CHECKED_GL_CALL(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (const void*) (4 * sizeof(float))));
+
+		// Draw pass reads the mesh per vertex and the particle per instance
+		CHECKED_GL_CALL(glBindVertexArray(drawVaoID[i]));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(3));
+		CHECKED_GL_CALL(glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride, (const void*) 0));
+		CHECKED_GL_CALL(glVertexAttribDivisor(3, 1));
+		CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, meshBufID));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+		CHECKED_GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, meshStride, (const void*) 0));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+		CHECKED_GL_CALL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, meshStride, (const void*) (3 * sizeof(float))));
+		CHECKED_GL_CALL(glEnableVertexAttribArray(2));
+		CHECKED_GL_CALL(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, meshStride, (const void*) (6 * sizeof(float))));
+		CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, meshEleBufID));
+		if (i == 0) {
+			CHECKED_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh->getIndices().size() * sizeof(unsigned int), mesh->getIndices().data(), GL_STATIC_DRAW));
+		}
+		CHECKED_GL_CALL(glBindVertexArray(0));
+
+		// Buffer texture view of the same storage for the lighting pass
+		CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, stateTexID[i]));
+		CHECKED_GL_CALL(glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, stateBufID[i]));
+	}
+	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, 0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+
+	return true;
+}
+
+void GpuParticleSystem::spawn(float mass, vec3 position, vec3 velocity)
+{
+	GpuParticle p;
+	p.position = position;
+	p.mass = mass;
+	p.velocity = velocity;
+	// Kept below 2^24 so the float round trip through the shader is exact
+	p.seed = (float) (nextSeed++ & 0xFFFFFF);
+	pending.push_back(p);
+}
+
+void GpuParticleSystem::clear()
+{
+	pending.clear();
+	count = 0;
+	nextSlot = 0;
+}
+
+void GpuParticleSystem::uploadPending()
+{
+	if (pending.empty()) return;
+
+	// More than a full buffer in one go only keeps the newest
+	size_t first = pending.size() > (size_t) capacity ? pending.size() - capacity : 0;
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stateBufID[current]));
+	for (size_t i = first; i < pending.size(); ) {
+		// Contiguous run up to the end of the ring
+		size_t run = std::min(pending.size() - i, (size_t) (capacity - nextSlot));
+		CHECKED_GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, nextSlot * sizeof(GpuParticle), run * sizeof(GpuParticle), &pending[i]));
+		nextSlot = (nextSlot + (int) run) % capacity;
+		count = std::min(count + (int) run, capacity);
+		i += run;
+	}
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	pending.clear();
+}
+
+void GpuParticleSystem::step(const GpuSimParams& params)
+{
+	uploadPending();
+	frame++;
+	if (count == 0) return;
+
+	int numMagnets = std::min((int) params.magnets.size(), MAX_GPU_MAGNETS);
+
+	updateProgram->bind();
+	CHECKED_GL_CALL(glUniform1f(updateProgram->getUniform("dt"), params.dt));
+	CHECKED_GL_CALL(glUniform1ui(updateProgram->getUniform("frame"), frame));
+	CHECKED_GL_CALL(glUniform1i(updateProgram->getUniform("isGravityOn"), params.isGravityOn));
+	CHECKED_GL_CALL(glUniform1i(updateProgram->getUniform("isCenterPointAttractive"), params.isCenterPointAttractive));
+	CHECKED_GL_CALL(glUniform3fv(updateProgram->getUniform("centerPoint"), 1, value_ptr(params.centerPoint)));
+	CHECKED_GL_CALL(glUniform1f(updateProgram->getUniform("domainHalfExtent"), params.domainHalfExtent));
+	CHECKED_GL_CALL(glUniform1i(updateProgram->getUniform("numMagnets"), numMagnets));
+	if (numMagnets > 0) {
+		CHECKED_GL_CALL(glUniform3fv(updateProgram->getUniform("magnets"), numMagnets, value_ptr(params.magnets[0])));
+	}
+
+	// Read current, capture into the other buffer
+	int next = 1 - current;
+	CHECKED_GL_CALL(glEnable(GL_RASTERIZER_DISCARD));
+	CHECKED_GL_CALL(glBindVertexArray(updateVaoID[current]));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, stateBufID[current]));
+	CHECKED_GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBufID[next]));
+	CHECKED_GL_CALL(glBeginTransformFeedback(GL_POINTS));
+	CHECKED_GL_CALL(glDrawArrays(GL_POINTS, 0, count));
+	CHECKED_GL_CALL(glEndTransformFeedback());
+	CHECKED_GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	CHECKED_GL_CALL(glDisable(GL_RASTERIZER_DISCARD));
+	updateProgram->unbind();
+
+	current = next;
+}
+
+void GpuParticleSystem::draw(const mat4& P, const mat4& V, float particleScale)
+{
+	if (count == 0) return;
+
+	drawProgram->bind();
+	CHECKED_GL_CALL(glUniformMatrix4fv(drawProgram->getUniform("P"), 1, GL_FALSE, value_ptr(P)));
+	CHECKED_GL_CALL(glUniformMatrix4fv(drawProgram->getUniform("V"), 1, GL_FALSE, value_ptr(V)));
+	CHECKED_GL_CALL(glUniform1f(drawProgram->getUniform("particleScale"), particleScale));
+	CHECKED_GL_CALL(glUniform1i(drawProgram->getUniform("isLightSource"), true));
+	// Keep the unused samplerBuffer off the unit the scene texture uses
+	CHECKED_GL_CALL(glUniform1i(drawProgram->getUniform("lightBuffer"), 1));
+
+	CHECKED_GL_CALL(glBindVertexArray(drawVaoID[current]));
+	CHECKED_GL_CALL(glDrawElementsInstanced(GL_TRIANGLES, meshIndexCount, GL_UNSIGNED_INT, (const void*) 0, count));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	drawProgram->unbind();
+}
+
+void GpuParticleSystem::bindStateTexture(GLenum textureUnit) const
+{
+	CHECKED_GL_CALL(glActiveTexture(textureUnit));
+	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_BUFFER, stateTexID[current]));
+}
@@ -0,0 +1,50 @@
+#include "../headers/GpuTimer.h"
+
+#include "../headers/GLSL.h"
+
+bool GpuTimer::init(int depth)
+{
+	queries.resize(depth);
+	tags.resize(depth);
+	CHECKED_GL_CALL(glGenQueries(depth, queries.data()));
+	return depth > 0;
+}
+
+void GpuTimer::begin(float tag)
+{
+	if (queries.empty() || pending == (int) queries.size()) return;
+	tags[head] = tag;
+	CHECKED_GL_CALL(glBeginQuery(GL_TIME_ELAPSED, queries[head]));
+	running = true;
+}
+
+void GpuTimer::end()
+{
+	if (!running) return;
+	CHECKED_GL_CALL(glEndQuery(GL_TIME_ELAPSED));
+	running = false;
+	head = (head + 1) % (int) queries.size();
+	pending++;
+}
+
+bool GpuTimer::poll(double& milliseconds)
+{
+	float tag;
+	return poll(milliseconds, tag);
+}
+
+bool GpuTimer::poll(double& milliseconds, float& tag)
+{
+	if (pending == 0) return false;
+	GLint available = 0;
+	CHECKED_GL_CALL(glGetQueryObjectiv(queries[tail], GL_QUERY_RESULT_AVAILABLE, &available));
+	if (!available) return false;
+
+	GLuint64 nanoseconds = 0;
+	CHECKED_GL_CALL(glGetQueryObjectui64v(queries[tail], GL_QUERY_RESULT, &nanoseconds));
+	milliseconds = nanoseconds / 1.0e6;
+	tag = tags[tail];
+	tail = (tail + 1) % (int) queries.size();
+	pending--;
+	return true;
+}
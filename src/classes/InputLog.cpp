@@ -0,0 +1,107 @@
+#include "../headers/InputLog.h"
+#include <iostream>
+
+static const char LogMagic[4] = { 'P', 'I', 'O', 'R' };
+// Version 2 added the run settings after the seed
+static const uint32_t LogVersion = 2;
+
+bool InputRecorder::open(const std::string& path, uint64_t seed, const RunSettings& settings)
+{
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not open input log for writing: '" << path << "'" << std::endl;
+		return false;
+	}
+	file.write(LogMagic, sizeof(LogMagic));
+	file.write((const char*) &LogVersion, sizeof(LogVersion));
+	file.write((const char*) &seed, sizeof(seed));
+	// Field by field like the records, flags as one byte each
+	uint8_t allowSleep = settings.allowSleep;
+	uint8_t gpuSimulation = settings.gpuSimulation;
+	file.write((const char*) &settings.integrator, sizeof(settings.integrator));
+	file.write((const char*) &settings.dt, sizeof(settings.dt));
+	file.write((const char*) &allowSleep, sizeof(allowSleep));
+	file.write((const char*) &gpuSimulation, sizeof(gpuSimulation));
+	return true;
+}
+
+void InputRecorder::record(const InputEvent& event)
+{
+	if (!file.is_open()) return;
+	// Field by field, the struct itself has padding
+	file.write((const char*) &event.step, sizeof(event.step));
+	file.write((const char*) &event.type, sizeof(event.type));
+	file.write((const char*) &event.x, sizeof(event.x));
+	file.write((const char*) &event.y, sizeof(event.y));
+}
+
+void InputRecorder::close(uint32_t finalStep)
+{
+	if (!file.is_open()) return;
+	InputEvent end = { finalStep, InputEvent::End, 0.0f, 0.0f };
+	record(end);
+	file.close();
+}
+
+bool InputReplay::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		std::cerr << "Could not open input log: '" << path << "'" << std::endl;
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version = 0;
+	file.read(magic, sizeof(magic));
+	file.read((char*) &version, sizeof(version));
+	if (!file || std::string(magic, 4) != std::string(LogMagic, 4)) {
+		std::cerr << "'" << path << "' is not an input log" << std::endl;
+		return false;
+	}
+	if (version != LogVersion) {
+		std::cerr << "'" << path << "' is input log version " << version << ", expected " << LogVersion << std::endl;
+		return false;
+	}
+
+	uint8_t allowSleep = 1;
+	uint8_t gpuSimulation = 0;
+	file.read((char*) &seed, sizeof(seed));
+	file.read((char*) &settings.integrator, sizeof(settings.integrator));
+	file.read((char*) &settings.dt, sizeof(settings.dt));
+	file.read((char*) &allowSleep, sizeof(allowSleep));
+	file.read((char*) &gpuSimulation, sizeof(gpuSimulation));
+	if (!file) {
+		std::cerr << "'" << path << "' has a truncated header" << std::endl;
+		return false;
+	}
+	settings.allowSleep = allowSleep != 0;
+	settings.gpuSimulation = gpuSimulation != 0;
+
+	events.clear();
+	cursor = 0;
+	endStep = 0;
+	while (true) {
+		InputEvent event;
+		file.read((char*) &event.step, sizeof(event.step));
+		file.read((char*) &event.type, sizeof(event.type));
+		file.read((char*) &event.x, sizeof(event.x));
+		file.read((char*) &event.y, sizeof(event.y));
+		if (!file) break;
+
+		if (event.type == InputEvent::End) {
+			endStep = event.step;
+			break;
+		}
+		events.push_back(event);
+		endStep = event.step + 1;
+	}
+	return true;
+}
+
+bool InputReplay::next(uint32_t step, InputEvent& event)
+{
+	if (cursor >= events.size() || events[cursor].step != step) return false;
+	event = events[cursor++];
+	return true;
+}
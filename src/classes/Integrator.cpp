@@ -0,0 +1,130 @@
+#include "../headers/Integrator.h"
+#include "../headers/ForceField.h"
+#include "../headers/Random.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+	const IntegratorType allTypes[] = {
+		IntegratorType::SymplecticEuler,
+		IntegratorType::VelocityVerlet,
+		IntegratorType::RungeKutta4,
+		IntegratorType::Adaptive
+	};
+
+	typedef ForcePipeline<PointField, UniformField, RadialFalloffField> BenchmarkForces;
+
+	// Potential energy matching each field, so kinetic + potential is conserved
+	float potentialEnergy(const BenchmarkForces& forces, const Particle& p)
+	{
+		const PointField& attraction = std::get<0>(forces.fields);
+		const UniformField& gravity = std::get<1>(forces.fields);
+		const RadialFalloffField& repulsion = std::get<2>(forces.fields);
+
+		// F = -(s / L) |d| d  =>  U = s / (3 L) |d|^3
+		float d = glm::length(p.position - attraction.center);
+		float energy = attraction.strength / (3.0f * attraction.distanceScale) * d * d * d;
+		// F = f  =>  U = -f . x
+		energy -= glm::dot(gravity.force, p.position);
+		// F = k d inside R  =>  U = k / 2 (R^2 - |d|^2)
+		for (const vec3& source : *repulsion.sources) {
+			vec3 away = p.position - source;
+			float r2 = glm::dot(away, away);
+			if (r2 < repulsion.radius * repulsion.radius) {
+				energy += 0.5f * repulsion.strength * (repulsion.radius * repulsion.radius - r2);
+			}
+		}
+		return energy;
+	}
+
+	// Summed in double so the measurement doesn't add drift of its own
+	double totalEnergy(const BenchmarkForces& forces, const vector<Particle*>& particles)
+	{
+		double energy = 0.0;
+		for (const Particle* p : particles) {
+			energy += 0.5 * p->mass * glm::dot(p->velocity, p->velocity);
+			energy += potentialEnergy(forces, *p);
+		}
+		return energy;
+	}
+}
+
+bool parseIntegratorType(const std::string& name, IntegratorType& type)
+{
+	for (IntegratorType t : allTypes) {
+		if (name == integratorName(t)) {
+			type = t;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* integratorName(IntegratorType type)
+{
+	switch (type) {
+		case IntegratorType::SymplecticEuler: return SymplecticEuler::name();
+		case IntegratorType::VelocityVerlet: return VelocityVerlet::name();
+		case IntegratorType::RungeKutta4: return RungeKutta4::name();
+		case IntegratorType::Adaptive: return AdaptiveSubsteps<VelocityVerlet>::name();
+	}
+	return "unknown";
+}
+
+void benchmarkIntegrators(float dt, int steps)
+{
+	const int particleCount = 1000;
+
+	vector<vec3> magnets;
+	magnets.push_back(vec3(0.5f, 0.0f, -2.0f));
+	magnets.push_back(vec3(-0.5f, 0.3f, -2.0f));
+	magnets.push_back(vec3(0.0f, -0.5f, -1.5f));
+
+	BenchmarkForces forces;
+	PointField& attraction = forces.get<0>();
+	attraction.enabled = true;
+	attraction.center = vec3(0, 0, -2);
+	attraction.distanceScale = 25.0f;
+	attraction.strength = 0.2f;
+	UniformField& gravity = forces.get<1>();
+	gravity.enabled = true;
+	gravity.force = vec3(0, -0.25f, 0);
+	RadialFalloffField& repulsion = forces.get<2>();
+	repulsion.enabled = true;
+	repulsion.sources = &magnets;
+	repulsion.radius = 1.0f;
+
+	printf("Integrator energy drift: %d particles, %d steps of %g s\n", particleCount, steps, dt);
+	printf("%-18s %14s %14s %14s\n", "integrator", "max drift", "final drift", "ns/particle");
+
+	for (IntegratorType type : allTypes) {
+		// Same starting state for every integrator
+		Random rng(12345);
+		vector<Particle*> particles;
+		for (int i = 0; i < particleCount; i++) {
+			vec3 position = attraction.center + vec3(rng.nextFloat(-1.0f, 1.0f), rng.nextFloat(-1.0f, 1.0f), rng.nextFloat(-1.0f, 1.0f));
+			vec3 velocity = vec3(rng.nextFloat(-0.1f, 0.1f), rng.nextFloat(-0.1f, 0.1f), rng.nextFloat(-0.1f, 0.1f));
+			particles.push_back(new Particle(rng.nextFloat(0.5f, 1.5f), position, velocity, vec3(0)));
+		}
+
+		double initial = totalEnergy(forces, particles);
+		double maxDrift = 0.0;
+		double elapsed = 0.0;
+		for (int s = 0; s < steps; s++) {
+			auto start = std::chrono::high_resolution_clock::now();
+			integrateParticles(type, particles, dt, forces);
+			elapsed += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			double drift = std::abs(totalEnergy(forces, particles) - initial) / std::abs(initial);
+			if (drift > maxDrift) maxDrift = drift;
+		}
+		double finalDrift = std::abs(totalEnergy(forces, particles) - initial) / std::abs(initial);
+
+		printf("%-18s %14.3e %14.3e %14.1f\n", integratorName(type), maxDrift, finalDrift, 1e9 * elapsed / ((double) steps * particleCount));
+
+		for (Particle* p : particles) delete p;
+	}
+}
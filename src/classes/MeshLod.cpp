@@ -0,0 +1,289 @@
+#include "../headers/MeshLod.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <tuple>
+
+// Symmetric 4x4 error quadric, upper triangle
+struct Quadric
+{
+	double a[10];
+
+	Quadric() { std::fill(a, a + 10, 0.0); }
+
+	// Squared distance to the plane nx + d = 0
+	static Quadric plane(const vec3& n, double d)
+	{
+		Quadric q;
+		q.a[0] = n.x * n.x; q.a[1] = n.x * n.y; q.a[2] = n.x * n.z; q.a[3] = n.x * d;
+		q.a[4] = n.y * n.y; q.a[5] = n.y * n.z; q.a[6] = n.y * d;
+		q.a[7] = n.z * n.z; q.a[8] = n.z * d;
+		q.a[9] = d * d;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& o)
+	{
+		for (int i = 0; i < 10; i++) a[i] += o.a[i];
+		return *this;
+	}
+
+	double error(const vec3& v) const
+	{
+		return a[0] * v.x * v.x + 2 * a[1] * v.x * v.y + 2 * a[2] * v.x * v.z + 2 * a[3] * v.x
+			+ a[4] * v.y * v.y + 2 * a[5] * v.y * v.z + 2 * a[6] * v.y
+			+ a[7] * v.z * v.z + 2 * a[8] * v.z
+			+ a[9];
+	}
+
+	// Position with the least error, false if the quadric is (near) singular
+	bool minimum(vec3& out) const
+	{
+		double det = a[0] * (a[4] * a[7] - a[5] * a[5]) - a[1] * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * a[5] - a[4] * a[2]);
+		if (std::fabs(det) < 1e-12) return false;
+		// Cramer's rule on A x = -b
+		double bx = -a[3], by = -a[6], bz = -a[8];
+		out.x = (bx * (a[4] * a[7] - a[5] * a[5]) - a[1] * (by * a[7] - a[5] * bz) + a[2] * (by * a[5] - a[4] * bz)) / det;
+		out.y = (a[0] * (by * a[7] - bz * a[5]) - bx * (a[1] * a[7] - a[5] * a[2]) + a[2] * (a[1] * bz - by * a[2])) / det;
+		out.z = (a[0] * (a[4] * bz - a[5] * by) - a[1] * (a[1] * bz - by * a[2]) + bx * (a[1] * a[5] - a[4] * a[2])) / det;
+		return true;
+	}
+};
+
+// Corner indices of one triangle
+struct Triangle
+{
+	int v[3];
+
+	int& operator[](int k) { return v[k]; }
+	int operator[](int k) const { return v[k]; }
+	bool isDegenerate() const { return v[0] == v[1] || v[1] == v[2] || v[0] == v[2]; }
+	bool has(int vertex) const { return v[0] == vertex || v[1] == vertex || v[2] == vertex; }
+};
+
+// Candidate collapse of edge (v0, v1) into v0 at target. Stamps tell stale
+// entries apart once either vertex has been touched by another collapse.
+struct Collapse
+{
+	double cost;
+	int v0, v1;
+	unsigned int stamp0, stamp1;
+	vec3 target;
+
+	bool operator<(const Collapse& o) const { return cost > o.cost; }
+};
+
+static vec3 faceNormal(const vec3& a, const vec3& b, const vec3& c)
+{
+	return glm::cross(b - a, c - a);
+}
+
+bool simplifyMesh(const vector<float>& positions, const vector<unsigned int>& indices, size_t targetTriangles,
+	vector<float>& outPositions, vector<float>& outNormals, vector<unsigned int>& outIndices)
+{
+	if (indices.size() < 3 || positions.size() < 9) return false;
+
+	// Weld vertices that share a position, so seams (split normals or UVs) collapse as one
+	vector<vec3> verts;
+	vector<int> remap(positions.size() / 3);
+	std::map<std::tuple<float, float, float>, int> welded;
+	for (size_t i = 0; i < remap.size(); i++) {
+		std::tuple<float, float, float> key(positions[3 * i + 0], positions[3 * i + 1], positions[3 * i + 2]);
+		auto found = welded.find(key);
+		if (found == welded.end()) {
+			found = welded.insert(std::make_pair(key, (int) verts.size())).first;
+			verts.push_back(vec3(std::get<0>(key), std::get<1>(key), std::get<2>(key)));
+		}
+		remap[i] = found->second;
+	}
+
+	vector<Triangle> tris;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		Triangle t = { { remap[indices[i]], remap[indices[i + 1]], remap[indices[i + 2]] } };
+		if (!t.isDegenerate()) tris.push_back(t);
+	}
+
+	// Per-vertex quadrics and triangle adjacency
+	vector<Quadric> quadrics(verts.size());
+	vector<vector<int> > vertTris(verts.size());
+	for (size_t t = 0; t < tris.size(); t++) {
+		vec3 n = faceNormal(verts[tris[t][0]], verts[tris[t][1]], verts[tris[t][2]]);
+		float length = glm::length(n);
+		if (length > 0.0f) n /= length;
+		Quadric q = Quadric::plane(n, -glm::dot(n, verts[tris[t][0]]));
+		for (int k = 0; k < 3; k++) {
+			quadrics[tris[t][k]] += q;
+			vertTris[tris[t][k]].push_back((int) t);
+		}
+	}
+
+	vector<bool> triAlive(tris.size(), true);
+	vector<bool> vertAlive(verts.size(), true);
+	vector<unsigned int> stamps(verts.size(), 0);
+	size_t liveTris = tris.size();
+
+	std::priority_queue<Collapse> queue;
+	auto pushEdge = [&](int v0, int v1) {
+		Quadric q = quadrics[v0];
+		q += quadrics[v1];
+		Collapse c;
+		c.v0 = v0;
+		c.v1 = v1;
+		c.stamp0 = stamps[v0];
+		c.stamp1 = stamps[v1];
+		// The minimum of a nearly flat neighbourhood can land far off the edge;
+		// then pick the best of the ends and the midpoint instead
+		vec3 middle = (verts[v0] + verts[v1]) * 0.5f;
+		float reach = glm::length(verts[v1] - verts[v0]);
+		if (!q.minimum(c.target) || glm::length(c.target - middle) > reach) {
+			vec3 options[3] = { verts[v0], verts[v1], middle };
+			c.target = options[0];
+			for (int i = 1; i < 3; i++) {
+				if (q.error(options[i]) < q.error(c.target)) c.target = options[i];
+			}
+		}
+		c.cost = q.error(c.target);
+		queue.push(c);
+	};
+	for (const Triangle& t : tris) {
+		for (int k = 0; k < 3; k++) {
+			int a = t[k], b = t[(k + 1) % 3];
+			// Each shared edge once, from its lower index
+			if (a < b) pushEdge(a, b);
+		}
+	}
+
+	// Would moving v (a corner of tri t) to target flip or squash that face?
+	auto flips = [&](int t, int v, const vec3& target) {
+		vec3 p[3] = { verts[tris[t][0]], verts[tris[t][1]], verts[tris[t][2]] };
+		vec3 before = faceNormal(p[0], p[1], p[2]);
+		for (int k = 0; k < 3; k++) if (tris[t][k] == v) p[k] = target;
+		vec3 after = faceNormal(p[0], p[1], p[2]);
+		return glm::dot(before, after) <= 0.2f * glm::length(before) * glm::length(after);
+	};
+
+	while (liveTris > targetTriangles && !queue.empty()) {
+		Collapse c = queue.top();
+		queue.pop();
+		if (!vertAlive[c.v0] || !vertAlive[c.v1] || stamps[c.v0] != c.stamp0 || stamps[c.v1] != c.stamp1) continue;
+
+		// Faces that keep both corners after the collapse must not flip
+		bool rejected = false;
+		for (int v : { c.v0, c.v1 }) {
+			for (int t : vertTris[v]) {
+				if (!triAlive[t]) continue;
+				bool shared = tris[t].has(c.v0) && tris[t].has(c.v1);
+				if (!shared && flips(t, v, c.target)) rejected = true;
+			}
+		}
+		if (rejected) continue;
+
+		// Fold v1 into v0
+		verts[c.v0] = c.target;
+		quadrics[c.v0] += quadrics[c.v1];
+		vertAlive[c.v1] = false;
+		for (int t : vertTris[c.v1]) {
+			if (!triAlive[t]) continue;
+			for (int k = 0; k < 3; k++) if (tris[t][k] == c.v1) tris[t][k] = c.v0;
+			if (tris[t].isDegenerate()) {
+				triAlive[t] = false;
+				liveTris--;
+			}
+			else {
+				vertTris[c.v0].push_back(t);
+			}
+		}
+		vertTris[c.v1].clear();
+
+		// Re-cost every edge around the merged vertex; its old entries go stale
+		stamps[c.v0]++;
+		for (int t : vertTris[c.v0]) {
+			if (!triAlive[t]) continue;
+			for (int k = 0; k < 3; k++) {
+				int other = tris[t][k];
+				if (other != c.v0) pushEdge(c.v0, other);
+			}
+		}
+	}
+
+	// Compact the survivors and give them smooth normals
+	vector<int> outIndex(verts.size(), -1);
+	outPositions.clear();
+	outIndices.clear();
+	vector<vec3> normals;
+	for (size_t t = 0; t < tris.size(); t++) {
+		if (!triAlive[t]) continue;
+		vec3 n = faceNormal(verts[tris[t][0]], verts[tris[t][1]], verts[tris[t][2]]);
+		for (int k = 0; k < 3; k++) {
+			int v = tris[t][k];
+			if (outIndex[v] < 0) {
+				outIndex[v] = (int) normals.size();
+				normals.push_back(vec3(0));
+				outPositions.push_back((float) verts[v].x);
+				outPositions.push_back((float) verts[v].y);
+				outPositions.push_back((float) verts[v].z);
+			}
+			normals[outIndex[v]] += n;
+			outIndices.push_back((unsigned int) outIndex[v]);
+		}
+	}
+	outNormals.clear();
+	for (vec3 n : normals) {
+		float length = glm::length(n);
+		if (length > 0.0f) n /= length;
+		outNormals.push_back((float) n.x);
+		outNormals.push_back((float) n.y);
+		outNormals.push_back((float) n.z);
+	}
+	return !outIndices.empty();
+}
+
+MeshLod::~MeshLod()
+{
+	for (Shape* s : owned) delete s;
+}
+
+void MeshLod::build(const Shape* source, const vector<float>& ratios, const vector<float>& minPixels)
+{
+	levels.assign(1, source);
+	this->minPixels = minPixels;
+	size_t sourceTriangles = source->getIndices().size() / 3;
+	for (float ratio : ratios) {
+		tinyobj::shape_t simplified;
+		size_t target = std::max((size_t) 4, (size_t) (sourceTriangles * ratio));
+		if (!simplifyMesh(source->getPositions(), source->getIndices(), target,
+			simplified.mesh.positions, simplified.mesh.normals, simplified.mesh.indices)) {
+			break;
+		}
+		Shape* level = new Shape();
+		level->createShape(simplified);
+		level->init();
+		level->measure();
+		owned.push_back(level);
+		levels.push_back(level);
+	}
+	// Without a billboard the coarsest level covers everything below
+	this->minPixels.resize(levels.size(), 0.0f);
+}
+
+int MeshLod::select(float pixels) const
+{
+	for (size_t i = 0; i < levels.size(); i++) {
+		if (pixels >= minPixels[i]) return (int) i;
+	}
+	return billboard ? (int) levels.size() : (int) levels.size() - 1;
+}
+
+size_t MeshLod::getTriangleCount(int level) const
+{
+	const Shape* shape = getShape(level);
+	return shape ? shape->getIndices().size() / 3 : 0;
+}
+
+float MeshLod::projectedPixels(const mat4& P, const vec3& viewPosition, float radius, int viewportHeight)
+{
+	float depth = std::max(-viewPosition.z, 1e-4f);
+	// P[1][1] is cot(fovy / 2), so this is the diameter over the viewport height
+	return radius * P[1][1] / depth * (float) viewportHeight;
+}
@@ -0,0 +1,94 @@
+#include "../headers/NeighborGrid.h"
+#include <algorithm>
+#include <cmath>
+
+void NeighborGrid::build(const vec3* positions, size_t count, float cellSize, size_t maxCells)
+{
+	vec3 low(0), high(0);
+	if (count > 0) {
+		low = high = positions[0];
+		for (size_t i = 1; i < count; i++) {
+			low = glm::min(low, positions[i]);
+			high = glm::max(high, positions[i]);
+		}
+	}
+
+	// Widen the cells until the grid fits the budget
+	vec3 extent = high - low;
+	for (;;) {
+		for (int a = 0; a < 3; a++) {
+			dims[a] = (int) std::min(std::floor(extent[a] / cellSize), (float) maxCells) + 1;
+		}
+		if ((size_t) dims[0] * dims[1] * dims[2] <= maxCells) break;
+		cellSize *= 1.25f;
+	}
+	origin = low;
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+
+	// Counting sort: histogram, prefix sum, scatter
+	size_t cells = getCellCount();
+	cellStart.assign(cells + 1, 0);
+	pointCell.resize(count);
+	for (size_t i = 0; i < count; i++) {
+		int cx, cy, cz;
+		cellOf(positions[i], cx, cy, cz);
+		pointCell[i] = cellIndex(cx, cy, cz);
+		cellStart[pointCell[i] + 1]++;
+	}
+	for (size_t c = 0; c < cells; c++) {
+		cellStart[c + 1] += cellStart[c];
+	}
+
+	order.resize(count);
+	x.resize(count);
+	y.resize(count);
+	z.resize(count);
+	// Scatter with a running cursor per cell; cellStart[c] ends up as cell c's end, so shift back after
+	for (size_t i = 0; i < count; i++) {
+		uint32_t k = cellStart[pointCell[i]]++;
+		order[k] = (uint32_t) i;
+		x[k] = positions[i].x;
+		y[k] = positions[i].y;
+		z[k] = positions[i].z;
+	}
+	for (size_t c = cells; c > 0; c--) {
+		cellStart[c] = cellStart[c - 1];
+	}
+	cellStart[0] = 0;
+}
+
+int NeighborGrid::neighborRanges(size_t cell, size_t* begin, size_t* end) const
+{
+	int cx = (int) (cell % dims[0]);
+	int cy = (int) ((cell / dims[0]) % dims[1]);
+	int cz = (int) (cell / ((size_t) dims[0] * dims[1]));
+
+	int ranges = 0;
+	if (cellStart[cell] != cellStart[cell + 1]) {
+		begin[ranges] = cellStart[cell];
+		end[ranges++] = cellStart[cell + 1];
+	}
+	for (int oz = -1; oz <= 1; oz++) {
+		for (int oy = -1; oy <= 1; oy++) {
+			for (int ox = -1; ox <= 1; ox++) {
+				int nx = cx + ox, ny = cy + oy, nz = cz + oz;
+				if ((ox | oy | oz) == 0) continue;
+				if (nx < 0 || ny < 0 || nz < 0 || nx >= dims[0] || ny >= dims[1] || nz >= dims[2]) continue;
+				int n = cellIndex(nx, ny, nz);
+				if (cellStart[n] == cellStart[n + 1]) continue;
+				begin[ranges] = cellStart[n];
+				end[ranges++] = cellStart[n + 1];
+			}
+		}
+	}
+	return ranges;
+}
+
+void NeighborGrid::cellOf(const vec3& position, int& cx, int& cy, int& cz) const
+{
+	vec3 g = (position - origin) * inverseCellSize;
+	cx = std::min(std::max((int) g.x, 0), dims[0] - 1);
+	cy = std::min(std::max((int) g.y, 0), dims[1] - 1);
+	cz = std::min(std::max((int) g.z, 0), dims[2] - 1);
+}
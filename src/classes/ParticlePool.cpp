@@ -0,0 +1,46 @@
+#include "../headers/ParticlePool.h"
+#include <new>
+
+ParticlePool::ParticlePool(size_t blockSize) : blockSize(blockSize)
+{
+}
+
+ParticlePool::~ParticlePool()
+{
+	for (Particle* block : blocks) {
+		for (size_t i = 0; i < blockSize; i++) block[i].~Particle();
+		::operator delete(block);
+	}
+}
+
+void ParticlePool::grow()
+{
+	Particle* block = static_cast<Particle*>(::operator new(blockSize * sizeof(Particle)));
+	for (size_t i = 0; i < blockSize; i++) {
+		new (&block[i]) Particle(0.0f, vec3(0), vec3(0), vec3(0));
+	}
+	blocks.push_back(block);
+
+	// Hand out the block front to back
+	freeList.reserve(freeList.size() + blockSize);
+	for (size_t i = blockSize; i-- > 0;) freeList.push_back(&block[i]);
+}
+
+void ParticlePool::reserve(size_t count)
+{
+	while (freeList.size() < count) grow();
+}
+
+Particle* ParticlePool::acquire(float mass, const vec3& position, const vec3& velocity)
+{
+	if (freeList.empty()) grow();
+	Particle* p = freeList.back();
+	freeList.pop_back();
+	*p = Particle(mass, position, velocity, vec3(0));
+	return p;
+}
+
+void ParticlePool::release(Particle* p)
+{
+	freeList.push_back(p);
+}
@@ -80,6 +80,15 @@ bool Program::init()
 	pid = glCreateProgram();
 	CHECKED_GL_CALL(glAttachShader(pid, VS));
 	CHECKED_GL_CALL(glAttachShader(pid, FS));
+	if (!feedbackVaryings.empty())
+	{
+		std::vector<const char *> names;
+		for (const std::string &name : feedbackVaryings)
+		{
+			names.push_back(name.c_str());
+		}
+		CHECKED_GL_CALL(glTransformFeedbackVaryings(pid, (GLsizei) names.size(), names.data(), GL_INTERLEAVED_ATTRIBS));
+	}
 	CHECKED_GL_CALL(glLinkProgram(pid));
 	CHECKED_GL_CALL(glGetProgramiv(pid, GL_LINK_STATUS, &rc));
 	if (!rc)
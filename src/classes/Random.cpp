@@ -0,0 +1,173 @@
+#include "../headers/Random.h"
+#include <atomic>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RANDOM_USE_SSE2
+#endif
+
+namespace
+{
+	std::atomic<uint64_t> globalSeed(0x853c49e6748fea9bULL);
+
+	uint64_t splitmix64(uint64_t& x)
+	{
+		uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	inline uint32_t rotl(uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	// Top 24 bits to [0, 1)
+	inline float toUnitFloat(uint32_t x)
+	{
+		return (float) (x >> 8) * (1.0f / 16777216.0f);
+	}
+}
+
+Random::Random(uint64_t seed)
+{
+	this->seed(seed);
+}
+
+void Random::seed(uint64_t seed, uint64_t stream)
+{
+	uint64_t x = seed ^ (stream * 0xd1342543de82ef95ULL);
+	for (int lane = 0; lane < 4; lane++) {
+		uint64_t a = splitmix64(x);
+		uint64_t b = splitmix64(x);
+		s[0][lane] = (uint32_t) a;
+		s[1][lane] = (uint32_t) (a >> 32);
+		s[2][lane] = (uint32_t) b;
+		s[3][lane] = (uint32_t) (b >> 32);
+		// All-zero state never leaves zero
+		if ((a | b) == 0) s[0][lane] = 1;
+	}
+	lane = 4;
+}
+
+void Random::advance(uint32_t out[4])
+{
+	for (int l = 0; l < 4; l++) {
+		out[l] = s[0][l] + s[3][l];
+		uint32_t t = s[1][l] << 9;
+		s[2][l] ^= s[0][l];
+		s[3][l] ^= s[1][l];
+		s[1][l] ^= s[2][l];
+		s[0][l] ^= s[3][l];
+		s[2][l] ^= t;
+		s[3][l] = rotl(s[3][l], 11);
+	}
+}
+
+uint32_t Random::nextUInt()
+{
+	if (lane >= 4) {
+		advance(buffered);
+		lane = 0;
+	}
+	return buffered[lane++];
+}
+
+float Random::nextFloat()
+{
+	return toUnitFloat(nextUInt());
+}
+
+float Random::nextFloat(float lowBound, float highBound)
+{
+	return nextFloat() * (highBound - lowBound) + lowBound;
+}
+
+void Random::fill(float* out, size_t count, float lowBound, float highBound)
+{
+	float range = highBound - lowBound;
+	size_t i = 0;
+
+	// Drain values left over from scalar calls so the sequence stays continuous
+	while (lane < 4 && i < count) {
+		out[i++] = toUnitFloat(buffered[lane++]) * range + lowBound;
+	}
+
+#ifdef RANDOM_USE_SSE2
+	__m128i s0 = _mm_loadu_si128((const __m128i*) s[0]);
+	__m128i s1 = _mm_loadu_si128((const __m128i*) s[1]);
+	__m128i s2 = _mm_loadu_si128((const __m128i*) s[2]);
+	__m128i s3 = _mm_loadu_si128((const __m128i*) s[3]);
+	const __m128 scale = _mm_set1_ps(1.0f / 16777216.0f);
+	const __m128 rangeV = _mm_set1_ps(range);
+	const __m128 lowV = _mm_set1_ps(lowBound);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i result = _mm_add_epi32(s0, s3);
+		__m128i t = _mm_slli_epi32(s1, 9);
+		s2 = _mm_xor_si128(s2, s0);
+		s3 = _mm_xor_si128(s3, s1);
+		s1 = _mm_xor_si128(s1, s2);
+		s0 = _mm_xor_si128(s0, s3);
+		s2 = _mm_xor_si128(s2, t);
+		s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+		// Same rounding as toUnitFloat: exact int to float, then scale
+		__m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), scale);
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(f, rangeV), lowV));
+	}
+
+	_mm_storeu_si128((__m128i*) s[0], s0);
+	_mm_storeu_si128((__m128i*) s[1], s1);
+	_mm_storeu_si128((__m128i*) s[2], s2);
+	_mm_storeu_si128((__m128i*) s[3], s3);
+#else
+	uint32_t block[4];
+	for (; i + 4 <= count; i += 4) {
+		advance(block);
+		for (int l = 0; l < 4; l++) {
+			out[i + l] = toUnitFloat(block[l]) * range + lowBound;
+		}
+	}
+#endif
+
+	// Tail goes through the scalar buffer
+	for (; i < count; i++) {
+		out[i] = nextFloat() * range + lowBound;
+	}
+}
+
+Random::State Random::getState() const
+{
+	State state;
+	for (int w = 0; w < 4; w++) {
+		for (int l = 0; l < 4; l++) {
+			state.s[w][l] = s[w][l];
+		}
+		state.buffered[w] = buffered[w];
+	}
+	state.lane = lane;
+	return state;
+}
+
+void Random::setState(const State& state)
+{
+	for (int w = 0; w < 4; w++) {
+		for (int l = 0; l < 4; l++) {
+			s[w][l] = state.s[w][l];
+		}
+		buffered[w] = state.buffered[w];
+	}
+	lane = state.lane;
+}
+
+void Random::setGlobalSeed(uint64_t seed)
+{
+	globalSeed = seed;
+}
+
+uint64_t Random::getGlobalSeed()
+{
+	return globalSeed;
+}
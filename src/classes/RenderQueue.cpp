@@ -0,0 +1,181 @@
+#include "../headers/RenderQueue.h"
+#include <algorithm>
+
+#include "../headers/GLSL.h"
+
+int RenderQueue::addMaterial(const Material& material)
+{
+	materials.push_back(material);
+	return (int) materials.size() - 1;
+}
+
+uint64_t RenderQueue::makeKey(const Program* prog, const Texture* tex, int materialId)
+{
+	uint64_t programBits = prog ? (prog->getPID() & 0xFFFF) : 0;
+	uint64_t textureBits = tex ? (tex->getID() & 0xFFFF) : 0;
+	uint64_t materialBits = materialId & 0xFFFF;
+
+	return (programBits << 48) | (textureBits << 32) | (materialBits << 16);
+}
+
+DrawCommand RenderQueue::makeCommand(Program* prog, Texture* tex, int materialId, const Shape* shape, const mat4& model) const
+{
+	DrawCommand cmd;
+	cmd.key = makeKey(prog, tex, materialId);
+	cmd.program = prog;
+	cmd.texture = tex;
+	cmd.materialId = materialId;
+	cmd.shape = shape;
+	cmd.batch = nullptr;
+	cmd.batchGroup = -1;
+	cmd.model = model;
+	return cmd;
+}
+
+void RenderQueue::submit(Program* prog, Texture* tex, int materialId, const Shape* shape, const mat4& model)
+{
+	DrawCommand cmd = makeCommand(prog, tex, materialId, shape, model);
+
+	std::lock_guard<std::mutex> guard(submitLock);
+	commands.push_back(cmd);
+}
+
+void RenderQueue::submit(const vector<DrawCommand>& batch)
+{
+	std::lock_guard<std::mutex> guard(submitLock);
+	commands.insert(commands.end(), batch.begin(), batch.end());
+}
+
+void RenderQueue::submit(Program* prog, Texture* tex, const StaticBatch* batch, const mat4& model)
+{
+	vector<DrawCommand> groupCommands;
+	for (int g = 0; g < batch->getGroupCount(); g++) {
+		int materialId = batch->getGroup(g).materialId;
+		Texture* groupTex = materials[materialId].isGlobeSphere ? tex : nullptr;
+
+		DrawCommand cmd = makeCommand(prog, groupTex, materialId, nullptr, model);
+		cmd.batch = batch;
+		cmd.batchGroup = g;
+		groupCommands.push_back(cmd);
+	}
+	submit(groupCommands);
+}
+
+void RenderQueue::bindProgram(Program* prog)
+{
+	prog->bind();
+	boundProgram = prog;
+	// Look up locations once per program switch rather than once per draw
+	loc.M = prog->getUniform("M");
+	loc.shapeColor = prog->getUniform("shapeColor");
+	loc.shininess = prog->getUniform("shininess");
+	loc.isLightSource = prog->getUniform("isLightSource");
+	loc.isGlobeSphere = prog->getUniform("isGlobeSphere");
+	loc.texture = prog->getUniform("globeTexture");
+	// A new program has its own uniform values
+	haveMaterial = false;
+	boundTexture = nullptr;
+	stateChanges++;
+}
+
+void RenderQueue::applyMaterial(const Material& material)
+{
+	// Only write the uniforms that actually differ from the last draw
+	if (!haveMaterial || material.color != lastMaterial.color) {
+		CHECKED_GL_CALL(glUniform3fv(loc.shapeColor, 1, value_ptr(material.color)));
+		stateChanges++;
+	}
+	else skippedWrites++;
+
+	if (!haveMaterial || material.shininess != lastMaterial.shininess) {
+		CHECKED_GL_CALL(glUniform1f(loc.shininess, material.shininess));
+		stateChanges++;
+	}
+	else skippedWrites++;
+
+	if (!haveMaterial || material.isLightSource != lastMaterial.isLightSource) {
+		CHECKED_GL_CALL(glUniform1i(loc.isLightSource, material.isLightSource));
+		stateChanges++;
+	}
+	else skippedWrites++;
+
+	if (!haveMaterial || material.isGlobeSphere != lastMaterial.isGlobeSphere) {
+		CHECKED_GL_CALL(glUniform1i(loc.isGlobeSphere, material.isGlobeSphere));
+		stateChanges++;
+	}
+	else skippedWrites++;
+
+	lastMaterial = material;
+	haveMaterial = true;
+}
+
+void RenderQueue::flush()
+{
+	vector<DrawCommand> frame;
+	{
+		std::lock_guard<std::mutex> guard(submitLock);
+		frame.swap(commands);
+	}
+
+	drawCount = 0;
+	stateChanges = 0;
+	skippedWrites = 0;
+	boundProgram = nullptr;
+	boundTexture = nullptr;
+	haveMaterial = false;
+
+	std::stable_sort(frame.begin(), frame.end(), [](const DrawCommand& a, const DrawCommand& b) {
+		return a.key < b.key;
+	});
+
+	int lastMaterialId = -1;
+	for (const DrawCommand& cmd : frame) {
+		if (cmd.program != boundProgram) {
+			bindProgram(cmd.program);
+			lastMaterialId = -1;
+		}
+		// Untextured draws leave whatever is bound, the shader doesn't sample it
+		if (cmd.texture && cmd.texture != boundTexture) {
+			cmd.texture->bind(loc.texture);
+			boundTexture = cmd.texture;
+			stateChanges++;
+		}
+		if (cmd.materialId != lastMaterialId) {
+			applyMaterial(materials[cmd.materialId]);
+			lastMaterialId = cmd.materialId;
+		}
+
+		CHECKED_GL_CALL(glUniformMatrix4fv(loc.M, 1, GL_FALSE, value_ptr(cmd.model)));
+		if (cmd.batch) {
+			cmd.batch->drawGroup(cmd.batchGroup);
+		}
+		else {
+			cmd.shape->draw(cmd.program);
+		}
+		drawCount++;
+	}
+
+	// Frame may carry a lot of commands; keep the capacity for next time
+	if (frame.capacity() > commands.capacity()) {
+		std::lock_guard<std::mutex> guard(submitLock);
+		if (commands.empty()) {
+			frame.clear();
+			commands.swap(frame);
+		}
+	}
+}
+
+void RenderQueue::drawDepth(Program* prog)
+{
+	std::lock_guard<std::mutex> guard(submitLock);
+	GLint modelLocation = prog->getUniform("M");
+	for (const DrawCommand& cmd : commands) {
+		CHECKED_GL_CALL(glUniformMatrix4fv(modelLocation, 1, GL_FALSE, value_ptr(cmd.model)));
+		if (cmd.batch) {
+			cmd.batch->drawGroup(cmd.batchGroup);
+		}
+		else {
+			cmd.shape->draw(prog);
+		}
+	}
+}
@@ -0,0 +1,183 @@
+#include "../headers/RenderTargetPool.h"
+
+#include "../headers/GLSL.h"
+
+RenderTargetPool::~RenderTargetPool()
+{
+	for (const Entry& entry : entries) destroy(entry);
+}
+
+GLuint RenderTargetPool::acquireTexture(int width, int height, GLenum internalFormat)
+{
+	return acquire(width, height, internalFormat, false);
+}
+
+GLuint RenderTargetPool::acquireDepth(int width, int height)
+{
+	return acquire(width, height, GL_DEPTH_COMPONENT, true);
+}
+
+GLuint RenderTargetPool::acquireDepthTexture(int width, int height)
+{
+	return acquire(width, height, GL_DEPTH_COMPONENT24, false);
+}
+
+GLuint RenderTargetPool::acquire(int width, int height, GLenum internalFormat, bool isRenderbuffer)
+{
+	for (Entry& entry : entries) {
+		if (!entry.inUse && entry.isRenderbuffer == isRenderbuffer && entry.width == width && entry.height == height && entry.internalFormat == internalFormat) {
+			entry.inUse = true;
+			entry.lastUsedFrame = frame;
+			return entry.id;
+		}
+	}
+
+	Entry entry = { 0, isRenderbuffer, width, height, internalFormat, true, frame };
+	if (isRenderbuffer) {
+		CHECKED_GL_CALL(glGenRenderbuffers(1, &entry.id));
+		CHECKED_GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, entry.id));
+		CHECKED_GL_CALL(glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height));
+		CHECKED_GL_CALL(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+	}
+	else {
+		CHECKED_GL_CALL(glGenTextures(1, &entry.id));
+		CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, entry.id));
+		bool isDepth = internalFormat == GL_DEPTH_COMPONENT24 || internalFormat == GL_DEPTH_COMPONENT32F;
+		GLint filter = isDepth ? GL_NEAREST : GL_LINEAR;
+		// Give an empty image to OpenGL (the NULL term)
+		CHECKED_GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, isDepth ? GL_DEPTH_COMPONENT : GL_RGB, GL_FLOAT, NULL));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+		CHECKED_GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+		CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+	}
+	entries.push_back(entry);
+	return entry.id;
+}
+
+void RenderTargetPool::release(GLuint id)
+{
+	for (Entry& entry : entries) {
+		if (entry.id == id) entry.inUse = false;
+	}
+}
+
+void RenderTargetPool::releaseAll()
+{
+	for (Entry& entry : entries) entry.inUse = false;
+}
+
+void RenderTargetPool::endFrame(uint32_t maxIdleFrames)
+{
+	size_t kept = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (!entries[i].inUse && frame - entries[i].lastUsedFrame > maxIdleFrames) {
+			destroy(entries[i]);
+		}
+		else {
+			entries[kept++] = entries[i];
+		}
+	}
+	entries.resize(kept);
+	frame++;
+}
+
+size_t RenderTargetPool::getBytesAllocated() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : entries) {
+		bytes += (size_t) entry.width * entry.height * bytesPerTexel(entry.internalFormat);
+	}
+	return bytes;
+}
+
+size_t RenderTargetPool::getBytesInUse() const
+{
+	size_t bytes = 0;
+	for (const Entry& entry : entries) {
+		if (entry.inUse) bytes += (size_t) entry.width * entry.height * bytesPerTexel(entry.internalFormat);
+	}
+	return bytes;
+}
+
+size_t RenderTargetPool::bytesPerTexel(GLenum internalFormat)
+{
+	switch (internalFormat) {
+		case GL_RGBA32F:
+			return 16;
+		case GL_RGB16F:
+		case GL_RGBA16F:
+			return 8;
+		case GL_R11F_G11F_B10F:
+		case GL_RGB10_A2:
+		case GL_RGBA8:
+		case GL_RGB8:
+		case GL_DEPTH_COMPONENT:
+		case GL_DEPTH_COMPONENT24:
+		case GL_DEPTH_COMPONENT32F:
+			return 4;
+		default:
+			return 4;
+	}
+}
+
+bool RenderTargetPool::isColorRenderable(GLenum internalFormat)
+{
+	// Try it on a small throwaway framebuffer, leaving the current one bound
+	GLint bound = 0;
+	CHECKED_GL_CALL(glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound));
+	GLuint texture = 0, fbo = 0;
+	CHECKED_GL_CALL(glGenTextures(1, &texture));
+	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, texture));
+	// Unchecked: an unknown format is an expected answer, not an error to report
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, 4, 4, 0, GL_RGB, GL_FLOAT, NULL);
+	bool accepted = glGetError() == GL_NO_ERROR;
+	CHECKED_GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+	CHECKED_GL_CALL(glGenFramebuffers(1, &fbo));
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fbo));
+	CHECKED_GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0));
+	bool complete = accepted && glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	CHECKED_GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, bound));
+	CHECKED_GL_CALL(glDeleteFramebuffers(1, &fbo));
+	CHECKED_GL_CALL(glDeleteTextures(1, &texture));
+	return complete;
+}
+
+void RenderTargetPool::destroy(const Entry& entry)
+{
+	if (entry.isRenderbuffer) {
+		CHECKED_GL_CALL(glDeleteRenderbuffers(1, &entry.id));
+	}
+	else {
+		CHECKED_GL_CALL(glDeleteTextures(1, &entry.id));
+	}
+}
+
+static const struct { const char* name; GLenum format; } colorFormats[] = {
+	{ "rgba32f", GL_RGBA32F },
+	{ "rgba16f", GL_RGBA16F },
+	{ "rgb16f", GL_RGB16F },
+	{ "r11f_g11f_b10f", GL_R11F_G11F_B10F },
+	{ "rgb10_a2", GL_RGB10_A2 },
+	{ "rgba8", GL_RGBA8 },
+};
+
+bool parseColorFormat(const std::string& name, GLenum& format)
+{
+	for (const auto& entry : colorFormats) {
+		if (name == entry.name) {
+			format = entry.format;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* colorFormatName(GLenum format)
+{
+	for (const auto& entry : colorFormats) {
+		if (format == entry.format) return entry.name;
+	}
+	return "unknown";
+}
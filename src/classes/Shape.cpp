@@ -13,6 +13,31 @@ void Shape::createShape(shape_t& shape)
 	norBuf = shape.mesh.normals;
 	texBuf = shape.mesh.texcoords;
 	eleBuf = shape.mesh.indices;
+
+	// OBJs without normals get smooth ones, summed from the faces around each vertex
+	if (norBuf.empty() && !eleBuf.empty()) {
+		norBuf.assign(posBuf.size(), 0.0f);
+		for (size_t i = 0; i + 2 < eleBuf.size(); i += 3) {
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; k++) {
+				p[k] = glm::vec3(posBuf[3 * eleBuf[i + k] + 0], posBuf[3 * eleBuf[i + k] + 1], posBuf[3 * eleBuf[i + k] + 2]);
+			}
+			// Unnormalized, so bigger faces weigh more
+			glm::vec3 n = glm::cross(p[1] - p[0], p[2] - p[0]);
+			for (int k = 0; k < 3; k++) {
+				for (int c = 0; c < 3; c++) norBuf[3 * eleBuf[i + k] + c] += n[c];
+			}
+		}
+		for (size_t v = 0; v < norBuf.size(); v += 3) {
+			glm::vec3 n(norBuf[v], norBuf[v + 1], norBuf[v + 2]);
+			float length = glm::length(n);
+			// Unreferenced or degenerate vertices still get a unit normal
+			n = length > 0.0f ? n / length : glm::vec3(0, 1, 0);
+			norBuf[v] = n.x;
+			norBuf[v + 1] = n.y;
+			norBuf[v + 2] = n.z;
+		}
+	}
 }
 
 void Shape::measure()
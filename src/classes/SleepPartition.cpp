@@ -0,0 +1,90 @@
+#include "../headers/SleepPartition.h"
+#include <algorithm>
+
+// Older particles have the larger age; ties keep the list they came from first
+static bool isOlder(const Particle* a, const Particle* b)
+{
+	return a->age > b->age;
+}
+
+size_t SleepPartition::park(vector<Particle*>& awake, const vec3* startVelocities, float dt)
+{
+	float speed2 = speedThreshold * speedThreshold;
+	float force2 = forceThreshold * forceThreshold;
+	for (size_t i = 0; i < awake.size(); i++) {
+		Particle* p = awake[i];
+		vec3 force = p->mass * (p->velocity - startVelocities[i]) / dt;
+		bool resting = glm::dot(p->velocity, p->velocity) < speed2 && glm::dot(force, force) < force2;
+		p->restSteps = resting ? p->restSteps + 1 : 0;
+	}
+	return parkRested(awake);
+}
+
+size_t SleepPartition::parkRested(vector<Particle*>& awake)
+{
+	parked.clear();
+	size_t kept = 0;
+	for (size_t i = 0; i < awake.size(); i++) {
+		Particle* p = awake[i];
+		if (p->restSteps >= sleepAfterSteps) {
+			p->velocity = vec3(0);
+			p->forces = vec3(0);
+			parked.push_back(p);
+		}
+		else {
+			awake[kept++] = p;
+		}
+	}
+	awake.resize(kept);
+	if (!parked.empty()) mergeByAge(asleep, parked);
+	return parked.size();
+}
+
+size_t SleepPartition::wakeAll(vector<Particle*>& awake)
+{
+	return wakeIf(awake, [](const Particle*) { return true; });
+}
+
+size_t SleepPartition::wakeNear(vector<Particle*>& awake, const vec3& point, float radius)
+{
+	float radius2 = radius * radius;
+	return wakeIf(awake, [&point, radius2](const Particle* p) {
+		vec3 offset = p->position - point;
+		return glm::dot(offset, offset) < radius2;
+	});
+}
+
+void SleepPartition::releaseOldest(vector<Particle*>& awake, size_t count, ParticlePool& pool)
+{
+	// Both lists are oldest first, so the oldest overall are at one of the fronts
+	size_t a = 0, s = 0;
+	while (a + s < count && (a < awake.size() || s < asleep.size())) {
+		if (s == asleep.size() || (a < awake.size() && !isOlder(asleep[s], awake[a]))) {
+			pool.release(awake[a++]);
+		}
+		else {
+			pool.release(asleep[s++]);
+		}
+	}
+	awake.erase(awake.begin(), awake.begin() + a);
+	asleep.erase(asleep.begin(), asleep.begin() + s);
+}
+
+void SleepPartition::clear(ParticlePool& pool)
+{
+	for (Particle* p : asleep) pool.release(p);
+	asleep.clear();
+}
+
+void SleepPartition::collect(const vector<Particle*>& awake, vector<Particle*>& out) const
+{
+	out.resize(awake.size() + asleep.size());
+	std::merge(awake.begin(), awake.end(), asleep.begin(), asleep.end(), out.begin(), isOlder);
+}
+
+void SleepPartition::mergeByAge(vector<Particle*>& into, const vector<Particle*>& from)
+{
+	merged.resize(into.size() + from.size());
+	std::merge(into.begin(), into.end(), from.begin(), from.end(), merged.begin(), isOlder);
+	into.swap(merged);
+}
@@ -0,0 +1,81 @@
+#include "../headers/SpriteRenderer.h"
+#include <iostream>
+
+#include "../headers/GLSL.h"
+
+bool SpriteRenderer::init(const std::string& resourceDirectory)
+{
+	program = new Program();
+	program->setVerbose(true);
+	program->setShaderNames(resourceDirectory + "/sprite_vert.glsl", resourceDirectory + "/sprite_frag.glsl");
+	if (!program->init()) {
+		std::cerr << "Sprite shader failed to compile" << std::endl;
+		return false;
+	}
+	program->addUniform("P");
+	program->addUniform("V");
+	program->addUniform("spriteRadius");
+
+	// Quad corners in strip order
+	const float corners[8] = { -1, -1, 1, -1, -1, 1, 1, 1 };
+	CHECKED_GL_CALL(glGenVertexArrays(1, &vaoID));
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+	CHECKED_GL_CALL(glGenBuffers(1, &cornerBufID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, cornerBufID));
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+	CHECKED_GL_CALL(glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const void*) 0));
+
+	// Instance attribute, pointed at a buffer on every draw
+	CHECKED_GL_CALL(glGenBuffers(1, &instanceBufID));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+	CHECKED_GL_CALL(glVertexAttribDivisor(1, 1));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	return true;
+}
+
+void SpriteRenderer::draw(const mat4& P, const mat4& V, const vec4* positions, size_t count, float radius)
+{
+	if (count == 0) return;
+
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, instanceBufID));
+	// Grow by half again so a slowly growing swarm doesn't reallocate every frame
+	if (count > instanceCapacity) instanceCapacity = count + count / 2;
+	// Orphan last frame's storage instead of waiting for the GPU to finish with it
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(vec4), NULL, GL_STREAM_DRAW));
+	CHECKED_GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(vec4), positions));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	drawInstances(P, V, instanceBufID, sizeof(vec4), count, radius);
+}
+
+void SpriteRenderer::drawBuffer(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t count, float radius)
+{
+	if (count == 0) return;
+	drawInstances(P, V, buffer, stride, count, radius);
+}
+
+void SpriteRenderer::drawInstances(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t count, float radius)
+{
+	program->bind();
+	CHECKED_GL_CALL(glUniformMatrix4fv(program->getUniform("P"), 1, GL_FALSE, value_ptr(P)));
+	CHECKED_GL_CALL(glUniformMatrix4fv(program->getUniform("V"), 1, GL_FALSE, value_ptr(V)));
+	CHECKED_GL_CALL(glUniform1f(program->getUniform("spriteRadius"), radius));
+
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+	CHECKED_GL_CALL(glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (const void*) 0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
+	// Additive glow, tested against the scene but leaving its depth alone
+	CHECKED_GL_CALL(glEnable(GL_BLEND));
+	CHECKED_GL_CALL(glBlendFunc(GL_ONE, GL_ONE));
+	CHECKED_GL_CALL(glDepthMask(GL_FALSE));
+	CHECKED_GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei) count));
+	CHECKED_GL_CALL(glDepthMask(GL_TRUE));
+	CHECKED_GL_CALL(glDisable(GL_BLEND));
+
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	program->unbind();
+}
@@ -0,0 +1,106 @@
+#include "../headers/StaticBatch.h"
+#include <algorithm>
+
+#include "../headers/GLSL.h"
+
+// Interleaved layout: position 3, normal 3, texcoord 2
+static const int FloatsPerVertex = 8;
+
+void StaticBatch::add(const Shape* shape, int materialId)
+{
+	Pending p = { shape, materialId };
+	pending.push_back(p);
+}
+
+void StaticBatch::init()
+{
+	// Keep sub-shapes of the same material next to each other in the buffers
+	std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+		return a.materialId < b.materialId;
+	});
+
+	vector<float> vertices;
+	vector<unsigned int> indices;
+
+	for (size_t i = 0; i < pending.size(); i++) {
+		min = (i == 0) ? pending[i].shape->min : glm::min(min, pending[i].shape->min);
+		max = (i == 0) ? pending[i].shape->max : glm::max(max, pending[i].shape->max);
+	}
+
+	for (const Pending& p : pending) {
+		const vector<float>& pos = p.shape->getPositions();
+		const vector<float>& nor = p.shape->getNormals();
+		const vector<float>& tex = p.shape->getTexCoords();
+		const vector<unsigned int>& ele = p.shape->getIndices();
+
+		size_t vertexCount = pos.size() / 3;
+		unsigned int baseVertex = (unsigned int) (vertices.size() / FloatsPerVertex);
+
+		// Missing normals or texcoords are filled with zeros
+		for (size_t v = 0; v < vertexCount; v++) {
+			vertices.push_back(pos[3 * v + 0]);
+			vertices.push_back(pos[3 * v + 1]);
+			vertices.push_back(pos[3 * v + 2]);
+			vertices.push_back(nor.empty() ? 0.0f : nor[3 * v + 0]);
+			vertices.push_back(nor.empty() ? 0.0f : nor[3 * v + 1]);
+			vertices.push_back(nor.empty() ? 0.0f : nor[3 * v + 2]);
+			vertices.push_back(tex.empty() ? 0.0f : tex[2 * v + 0]);
+			vertices.push_back(tex.empty() ? 0.0f : tex[2 * v + 1]);
+		}
+
+		Range range;
+		range.source = p.shape;
+		range.count = (GLsizei) ele.size();
+		range.firstIndex = (GLuint) indices.size();
+
+		// Rebase indices into the merged vertex buffer
+		for (unsigned int i : ele) {
+			indices.push_back(i + baseVertex);
+		}
+
+		if (groups.empty() || groups.back().materialId != p.materialId) {
+			Group g;
+			g.materialId = p.materialId;
+			groups.push_back(g);
+		}
+		Group& g = groups.back();
+		g.ranges.push_back(range);
+		g.counts.push_back(range.count);
+		g.offsets.push_back((const void*) (range.firstIndex * sizeof(unsigned int)));
+	}
+	pending.clear();
+
+	CHECKED_GL_CALL(glGenVertexArrays(1, &vaoID));
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+
+	CHECKED_GL_CALL(glGenBuffers(1, &vboID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vboID));
+	CHECKED_GL_CALL(glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW));
+
+	CHECKED_GL_CALL(glGenBuffers(1, &eboID));
+	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboID));
+	CHECKED_GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW));
+
+	// Locations match the layout qualifiers in scene_vert.glsl
+	GLsizei stride = FloatsPerVertex * sizeof(float);
+	CHECKED_GL_CALL(glEnableVertexAttribArray(0));
+	CHECKED_GL_CALL(glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (const void*) 0));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(1));
+	CHECKED_GL_CALL(glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (const void*) (3 * sizeof(float))));
+	CHECKED_GL_CALL(glEnableVertexAttribArray(2));
+	CHECKED_GL_CALL(glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (const void*) (6 * sizeof(float))));
+
+	// The VAO keeps the element buffer binding, so unbind the VAO first
+	CHECKED_GL_CALL(glBindVertexArray(0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+	CHECKED_GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
+}
+
+void StaticBatch::drawGroup(int group) const
+{
+	const Group& g = groups[group];
+
+	CHECKED_GL_CALL(glBindVertexArray(vaoID));
+	CHECKED_GL_CALL(glMultiDrawElements(GL_TRIANGLES, g.counts.data(), GL_UNSIGNED_INT, g.offsets.data(), (GLsizei) g.counts.size()));
+	CHECKED_GL_CALL(glBindVertexArray(0));
+}
@@ -0,0 +1,82 @@
+#include "../headers/ThreadPool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i = 1; i < threads; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0) return;
+	grain = std::max<size_t>(grain, 1);
+
+	// Not worth waking anyone for a single chunk
+	if (workers.empty() || count <= grain) {
+		body(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->body = &body;
+		this->count = count;
+		this->grain = grain;
+		nextChunk = 0;
+		busyWorkers = (unsigned) workers.size();
+		generation++;
+	}
+	wake.notify_all();
+
+	runChunks();
+
+	// The job lives on our stack, so wait for every worker to let go of it
+	std::unique_lock<std::mutex> guard(lock);
+	done.wait(guard, [this] { return busyWorkers == 0; });
+	this->body = nullptr;
+}
+
+void ThreadPool::runChunks()
+{
+	for (;;) {
+		size_t begin = nextChunk.fetch_add(grain);
+		if (begin >= count) break;
+		(*body)(begin, std::min(begin + grain, count));
+	}
+}
+
+void ThreadPool::workerLoop()
+{
+	uint64_t seen = 0;
+	std::unique_lock<std::mutex> guard(lock);
+	for (;;) {
+		wake.wait(guard, [&] { return stopping || generation != seen; });
+		if (stopping) return;
+		seen = generation;
+
+		guard.unlock();
+		runChunks();
+		guard.lock();
+
+		if (--busyWorkers == 0) done.notify_one();
+	}
+}
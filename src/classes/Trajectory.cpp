@@ -0,0 +1,393 @@
+#include "../headers/Trajectory.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char FileMagic[4] = { 'P', 'I', 'O', 'T' };
+static const char FooterMagic[4] = { 'P', 'I', 'O', 'I' };
+static const uint32_t FileVersion = 1;
+static const uint32_t FlagCompressed = 1;
+static const size_t HeaderSize = 20;
+static const size_t IndexEntrySize = 24;
+static const size_t FooterSize = 16;
+// Largest quantized magnitude, so a delta between two of them still fits in an int32
+static const double QuantizedLimit = 1073741823.0;
+
+namespace
+{
+	template <typename T>
+	void put(vector<unsigned char>& out, const T& value)
+	{
+		const unsigned char* bytes = (const unsigned char*) &value;
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	template <typename T>
+	T get(const unsigned char* in)
+	{
+		T value;
+		memcpy(&value, in, sizeof(T));
+		return value;
+	}
+
+	void putVarint(vector<unsigned char>& out, int32_t value)
+	{
+		// Zigzag so small negative deltas stay short
+		uint32_t v = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);
+		while (v >= 0x80) {
+			out.push_back((unsigned char) (v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((unsigned char) v);
+	}
+
+	// False if the varint runs past end or is longer than five bytes
+	bool getVarint(const unsigned char*& in, const unsigned char* end, int32_t& value)
+	{
+		uint32_t v = 0;
+		for (int shift = 0; shift < 35 && in < end; shift += 7) {
+			unsigned char byte = *in++;
+			v |= (uint32_t) (byte & 0x7F) << shift;
+			if (!(byte & 0x80)) {
+				value = (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+	close();
+}
+
+bool TrajectoryWriter::open(const std::string& path, float quantizationStep, uint32_t keyframeInterval)
+{
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		std::cerr << "Could not open trajectory file for writing: '" << path << "'" << std::endl;
+		return false;
+	}
+	this->quantizationStep = quantizationStep;
+	this->keyframeInterval = keyframeInterval > 0 ? keyframeInterval : 1;
+
+	vector<unsigned char> header;
+	header.insert(header.end(), FileMagic, FileMagic + 4);
+	put(header, FileVersion);
+	put(header, (uint32_t) (quantizationStep > 0.0f ? FlagCompressed : 0));
+	put(header, quantizationStep);
+	put(header, this->keyframeInterval);
+	file.write((const char*) header.data(), header.size());
+
+	closing = false;
+	worker = std::thread(&TrajectoryWriter::writerLoop, this);
+	return true;
+}
+
+void TrajectoryWriter::submit(uint32_t step, const vector<vec3>& positions, const vector<vec3>& velocities)
+{
+	if (!file.is_open()) return;
+
+	// Split into columns here so the writer thread only encodes
+	TrajectoryFrame frame;
+	frame.step = step;
+	size_t count = positions.size();
+	for (int c = 0; c < 6; c++) frame.columns[c].resize(count);
+	for (size_t i = 0; i < count; i++) {
+		for (int c = 0; c < 3; c++) {
+			frame.columns[c][i] = positions[i][c];
+			frame.columns[3 + c][i] = velocities[i][c];
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		queue.push_back(std::move(frame));
+	}
+	queueReady.notify_one();
+}
+
+void TrajectoryWriter::writerLoop()
+{
+	while (true) {
+		TrajectoryFrame frame;
+		{
+			std::unique_lock<std::mutex> guard(queueLock);
+			queueReady.wait(guard, [this] { return closing || !queue.empty(); });
+			if (queue.empty()) return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		writeFrame(frame);
+	}
+}
+
+void TrajectoryWriter::writeFrame(const TrajectoryFrame& frame)
+{
+	uint32_t count = (uint32_t) frame.columns[0].size();
+	vector<unsigned char> chunk;
+
+	IndexEntry entry;
+	entry.step = frame.step;
+	entry.count = count;
+	entry.offset = (uint64_t) file.tellp();
+	entry.keyframe = 1;
+
+	if (quantizationStep <= 0.0f) {
+		for (int c = 0; c < 6; c++) {
+			const unsigned char* bytes = (const unsigned char*) frame.columns[c].data();
+			chunk.insert(chunk.end(), bytes, bytes + count * sizeof(float));
+		}
+	}
+	else {
+		// Deltas only make sense when particle i is the same particle as last frame
+		bool keyframe = sinceKeyframe == 0 || previous[0].size() != count;
+		entry.keyframe = keyframe ? 1 : 0;
+		sinceKeyframe = keyframe ? 1 : (sinceKeyframe + 1) % keyframeInterval;
+
+		for (int c = 0; c < 6; c++) {
+			vector<unsigned char> column;
+			vector<int32_t> quantized(count);
+			for (uint32_t i = 0; i < count; i++) {
+				// Clamp rather than let lround and the delta wrap for tiny steps
+				double scaled = frame.columns[c][i] / (double) quantizationStep;
+				if (!(std::fabs(scaled) <= QuantizedLimit)) {
+					scaled = std::isnan(scaled) ? 0.0 : std::min(std::max(scaled, -QuantizedLimit), QuantizedLimit);
+					clampedValues++;
+				}
+				quantized[i] = (int32_t) std::lround(scaled);
+				putVarint(column, keyframe ? quantized[i] : quantized[i] - previous[c][i]);
+			}
+			put(chunk, (uint32_t) column.size());
+			chunk.insert(chunk.end(), column.begin(), column.end());
+			previous[c].swap(quantized);
+		}
+	}
+
+	entry.size = (uint32_t) chunk.size();
+	file.write((const char*) chunk.data(), chunk.size());
+	index.push_back(entry);
+}
+
+void TrajectoryWriter::close()
+{
+	if (!file.is_open()) return;
+
+	{
+		std::lock_guard<std::mutex> guard(queueLock);
+		closing = true;
+	}
+	queueReady.notify_one();
+	if (worker.joinable()) worker.join();
+
+	uint64_t indexOffset = (uint64_t) file.tellp();
+	vector<unsigned char> tail;
+	for (const IndexEntry& e : index) {
+		put(tail, e.step);
+		put(tail, e.count);
+		put(tail, e.offset);
+		put(tail, e.size);
+		put(tail, e.keyframe);
+	}
+	put(tail, indexOffset);
+	put(tail, (uint32_t) index.size());
+	tail.insert(tail.end(), FooterMagic, FooterMagic + 4);
+	file.write((const char*) tail.data(), tail.size());
+	file.close();
+
+	if (clampedValues > 0) {
+		std::cerr << clampedValues << " trajectory values were out of range for quantization step " << quantizationStep << " and were clamped" << std::endl;
+	}
+}
+
+TrajectoryReader::~TrajectoryReader()
+{
+	close();
+}
+
+bool TrajectoryReader::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE) {
+		fileHandle = nullptr;
+		std::cerr << "Could not open trajectory file: '" << path << "'" << std::endl;
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	size = (size_t) fileSize.QuadPart;
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	data = mappingHandle ? (const unsigned char*) MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+#else
+	fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		std::cerr << "Could not open trajectory file: '" << path << "'" << std::endl;
+		return false;
+	}
+	struct stat info;
+	fstat(fd, &info);
+	size = (size_t) info.st_size;
+	void* mapped = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	data = mapped == MAP_FAILED ? nullptr : (const unsigned char*) mapped;
+#endif
+
+	if (!data || size < HeaderSize + FooterSize || memcmp(data, FileMagic, 4) != 0 || memcmp(data + size - 4, FooterMagic, 4) != 0) {
+		std::cerr << "'" << path << "' is not a complete trajectory file" << std::endl;
+		close();
+		return false;
+	}
+
+	flags = get<uint32_t>(data + 8);
+	quantizationStep = get<float>(data + 12);
+	indexOffset = get<uint64_t>(data + size - FooterSize);
+	frameCount = get<uint32_t>(data + size - FooterSize + 8);
+	if (!validateIndex()) {
+		std::cerr << "'" << path << "' has a corrupt frame index" << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool TrajectoryReader::validateIndex() const
+{
+	// The index sits between the header and the footer
+	uint64_t indexEnd = size - FooterSize;
+	if (indexOffset < HeaderSize || indexOffset > indexEnd) return false;
+	if (frameCount > (indexEnd - indexOffset) / IndexEntrySize) return false;
+
+	for (uint32_t f = 0; f < frameCount; f++) {
+		const unsigned char* entry = indexEntry(f);
+		uint64_t count = get<uint32_t>(entry + 4);
+		uint64_t offset = get<uint64_t>(entry + 8);
+		uint64_t chunkSize = get<uint32_t>(entry + 16);
+		if (offset < HeaderSize || offset > indexOffset || chunkSize > indexOffset - offset) return false;
+
+		if (!(flags & FlagCompressed)) {
+			if (chunkSize != count * 6 * sizeof(float)) return false;
+			continue;
+		}
+		// Deltas apply to the previous frame's particles, so the count can't change
+		if (get<uint32_t>(entry + 20) == 0 && f > 0 && count != get<uint32_t>(indexEntry(f - 1) + 4)) return false;
+		// Six length prefixed columns filling the chunk
+		uint64_t used = 0;
+		for (int c = 0; c < 6; c++) {
+			if (chunkSize - used < 4) return false;
+			uint64_t length = get<uint32_t>(data + offset + used);
+			used += 4;
+			// Every value takes at least a byte
+			if (length > chunkSize - used || length < count) return false;
+			used += length;
+		}
+		if (used != chunkSize) return false;
+	}
+	return true;
+}
+
+void TrajectoryReader::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle) CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data) munmap((void*) data, size);
+	if (fd >= 0) ::close(fd);
+	fd = -1;
+#endif
+	data = nullptr;
+	size = 0;
+	frameCount = 0;
+}
+
+const unsigned char* TrajectoryReader::indexEntry(uint32_t frame) const
+{
+	return data + indexOffset + frame * IndexEntrySize;
+}
+
+uint32_t TrajectoryReader::getStep(uint32_t frame) const
+{
+	return get<uint32_t>(indexEntry(frame));
+}
+
+uint32_t TrajectoryReader::getParticleCount(uint32_t frame) const
+{
+	return get<uint32_t>(indexEntry(frame) + 4);
+}
+
+bool TrajectoryReader::decodeColumns(uint32_t frame, vector<int32_t> quantized[6]) const
+{
+	// Walk back to the keyframe, then apply deltas forward
+	uint32_t first = frame;
+	while (first > 0 && get<uint32_t>(indexEntry(first) + 20) == 0) first--;
+
+	for (uint32_t f = first; f <= frame; f++) {
+		const unsigned char* entry = indexEntry(f);
+		uint32_t count = get<uint32_t>(entry + 4);
+		const unsigned char* in = data + get<uint64_t>(entry + 8);
+		bool keyframe = f == first;
+
+		for (int c = 0; c < 6; c++) {
+			// Column lengths were checked against the chunk on open
+			const unsigned char* column = in + 4;
+			in = column + get<uint32_t>(in);
+			quantized[c].resize(count);
+			for (uint32_t i = 0; i < count; i++) {
+				int32_t value;
+				if (!getVarint(column, in, value)) return false;
+				quantized[c][i] = keyframe ? value : (int32_t) ((uint32_t) quantized[c][i] + (uint32_t) value);
+			}
+		}
+	}
+	return true;
+}
+
+bool TrajectoryReader::readFrame(uint32_t frame, vector<vec3>& positions, vector<vec3>& velocities) const
+{
+	if (!data || frame >= frameCount) return false;
+
+	uint32_t count = getParticleCount(frame);
+	positions.resize(count);
+	velocities.resize(count);
+
+	if (flags & FlagCompressed) {
+		vector<int32_t> quantized[6];
+		if (!decodeColumns(frame, quantized)) {
+			std::cerr << "Trajectory frame " << frame << " is corrupt" << std::endl;
+			return false;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			for (int c = 0; c < 3; c++) {
+				positions[i][c] = quantized[c][i] * quantizationStep;
+				velocities[i][c] = quantized[3 + c][i] * quantizationStep;
+			}
+		}
+	}
+	else {
+		const unsigned char* in = data + get<uint64_t>(indexEntry(frame) + 8);
+		for (int c = 0; c < 6; c++) {
+			for (uint32_t i = 0; i < count; i++) {
+				float value = get<float>(in + (c * count + i) * sizeof(float));
+				if (c < 3) positions[i][c] = value;
+				else velocities[i][c - 3] = value;
+			}
+		}
+	}
+	return true;
+}
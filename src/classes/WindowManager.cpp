@@ -44,6 +44,9 @@ bool WindowManager::init(int const width, int const height, const char *name)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+#if defined(OPENGL_DEBUG_OUTPUT) && !defined(NDEBUG)
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 	// Create a windowed mode window and its OpenGL context.
 	windowHandle = glfwCreateWindow(width, height, name, nullptr, nullptr);
@@ -65,6 +68,11 @@ bool WindowManager::init(int const width, int const height, const char *name)
 	std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
 	std::cout << "GLSL version: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+#if defined(OPENGL_DEBUG_OUTPUT) && !defined(NDEBUG)
+	// Route GL errors through the debug callback instead of per-call glGetError
+	GLSL::enableDebugOutput();
+#endif
+
 	// Set vsync
 	glfwSwapInterval(1);
 
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef BVH_H
+#define BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Shape.h"
+
+using ::glm::mat4;
+using ::glm::vec3;
+using ::std::vector;
+
+// Closest crossing of a segment with the meshes
+struct SegmentHit
+{
+	bool hit = false;
+	// Fraction along the segment, 0 at from and 1 at to
+	float t = 1.0f;
+	vec3 point = vec3(0);
+	// Unit triangle normal, facing back against the segment
+	vec3 normal = vec3(0);
+};
+
+// Bounding volume hierarchy over the triangles of a few static meshes, kept
+// in world space. Leaves hold up to four triangles as one structure-of-arrays
+// packet, tested together with SSE2 where available. Moving a mesh refits
+// the bounds in place; the tree is only rebuilt by build().
+class TriangleBvh
+{
+public:
+	// Adds a mesh's triangles; returns its id for setTransform. Call build() after the last one.
+	size_t addShape(const Shape* shape, const mat4& model);
+	void build();
+
+	// Moves a mesh; refit() applies every pending move in one pass
+	void setTransform(size_t mesh, const mat4& model);
+	void refit();
+
+	bool intersectSegment(const vec3& from, const vec3& to, SegmentHit& hit) const;
+	// Many segments at once, split across the shared thread pool
+	void intersectSegments(const vec3* from, const vec3* to, size_t count, SegmentHit* hits) const;
+
+	size_t getTriangleCount() const { return triangleMesh.size(); }
+	size_t getNodeCount() const { return nodes.size(); }
+
+private:
+	// Interior nodes have count 0; the left child follows the node, right is the
+	// child index. Leaves have count 1-4 and right is the packet index.
+	struct Node
+	{
+		vec3 min;
+		uint32_t right;
+		vec3 max;
+		uint32_t count;
+	};
+
+	// Four triangles as vertex 0 plus two edges, one lane each; unused lanes are degenerate
+	struct Packet
+	{
+		float v0[3][4];
+		float e1[3][4];
+		float e2[3][4];
+	};
+
+	uint32_t buildNode(uint32_t begin, uint32_t end);
+	void fillPacket(uint32_t packet);
+	void updateWorldVertices(size_t mesh);
+
+	vector<mat4> meshModels;
+	vector<bool> meshDirty;
+	// Three vertices per triangle, in mesh space and in world space
+	vector<vec3> localVertices;
+	vector<vec3> worldVertices;
+	vector<uint32_t> triangleMesh;
+
+	vector<Node> nodes;
+	vector<Packet> packets;
+	// Triangles in leaf order; packet p holds order[packetStart[p]] onwards
+	vector<uint32_t> order;
+	vector<uint32_t> packetStart;
+	vector<uint32_t> packetCount;
+	vector<vec3> centroids;
+};
+
+#endif // BVH_H
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Random.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Flat copy of one particle, written to disk as is
+struct ParticleRecord
+{
+	float mass;
+	vec3 position;
+	vec3 velocity;
+	vec3 forces;
+	float age;
+	float lifetime;
+	uint32_t restSteps;
+};
+
+// Everything needed to resume the simulation exactly
+struct SimulationSnapshot
+{
+	uint32_t simStep = 0;
+	float simTime = 0.0f;
+	bool isGravityOn = false;
+	bool isMagnetModeOn = false;
+	bool isCenterPointAttractive = false;
+	bool isFlockingOn = false;
+	bool isFluidOn = false;
+	bool areEmittersOn = false;
+	Random::State rng;
+	vector<ParticleRecord> fireflies;
+	vector<ParticleRecord> magnets;
+	// Fractional spawns owed by each emitter
+	vector<float> emitterCarry;
+};
+
+// Writes snapshots on a background thread. The caller hands over its own copy
+// of the state, so the sim thread only pays for that copy and never waits on disk.
+// Layout: "PIOC", u32 version, u32 step, f32 time, u32 toggle bits, rng state,
+// u32 firefly count, u32 magnet count, the ParticleRecord arrays, then
+// u32 emitter count and the emitter carries.
+class CheckpointWriter
+{
+public:
+	~CheckpointWriter();
+
+	// Returns false (and drops the snapshot) if the previous save is still running
+	bool save(SimulationSnapshot&& snapshot, const std::string& path);
+	// Blocks until any running save has finished
+	void wait();
+
+private:
+	std::thread worker;
+	std::atomic<bool> busy{ false };
+};
+
+// Reads a checkpoint; two bulk reads for the particle arrays. Counts larger
+// than the file can hold are rejected as corrupt.
+bool loadCheckpoint(const std::string& path, SimulationSnapshot& snapshot);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,71 @@
+#pragma once
+#ifndef DEFERREDRENDERER_H
+#define DEFERREDRENDERER_H
+
+#include <cstddef>
+#include <string>
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Program.h"
+
+using ::glm::mat4;
+using ::glm::vec4;
+
+// Deferred alternative to the forward scene shader. Surfaces are drawn once
+// into a G-buffer (normal, albedo and shininess, depth), then every light
+// draws a sphere bounding its reach and shades only the pixels inside it, so
+// lighting cost follows screen coverage instead of fragments times lights.
+// Light sources and the idle light slots at the origin are written by the
+// G-buffer pass itself, and a last pass picks the bloom brights out of the
+// lit scene. Lights beyond the volume radius are left out, as are dead slots
+// of a GPU light buffer, which the forward shader counts as idle lights.
+class DeferredRenderer
+{
+public:
+	bool init(const std::string& resourceDirectory);
+
+	// Surface program for the render queue, with the scene shader's uniforms
+	// (P, V, M, material, globeTexture) plus numIdleLights
+	Program* getGeometryProgram() const { return geometryProgram; }
+
+	// This frame's targets: the scene and brights attachments the bloom reads,
+	// two RGBA16F G-buffer textures and a depth texture
+	void setTargets(GLuint sceneColor, GLuint brights, GLuint normal, GLuint albedo, GLuint depth);
+
+	// Binds and clears the G-buffer for the surface draws
+	void beginGeometry();
+	// Adds count lights at vec4(position, 1), each reaching radius
+	void drawLights(const mat4& P, const mat4& V, const vec4* positions, size_t count, float radius, int width, int height);
+	// Same, read as vec4(position, mass) every stride bytes of buffer from slot first on
+	void drawLightBuffer(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t first, size_t count, float radius, int width, int height);
+	// Fills the brights from the lit scene, then leaves the scene, brights and
+	// depth bound for overlays such as sprites
+	void resolve();
+
+private:
+	void drawVolumes(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t first, size_t count, float radius, int width, int height);
+	static void bindTexture(GLenum unit, GLuint texture);
+
+	Program* geometryProgram = nullptr;
+	Program* lightProgram = nullptr;
+	Program* brightsProgram = nullptr;
+
+	// G-buffer (scene, brights, normal, albedo, depth), light accumulation
+	// (scene) and brights extraction (brights)
+	GLuint gBufferFBO = 0;
+	GLuint lightFBO = 0;
+	GLuint brightsFBO = 0;
+	GLuint targets[5] = { 0, 0, 0, 0, 0 };
+
+	// Light volume mesh, instanced once per light
+	GLuint volumeVAO = 0;
+	GLuint volumeBufID = 0;
+	GLsizei volumeVertexCount = 0;
+	GLuint instanceBufID = 0;
+	size_t instanceCapacity = 0;
+	// Fullscreen passes need a VAO bound even with no attributes
+	GLuint emptyVAO = 0;
+};
+
+#endif // DEFERREDRENDERER_H
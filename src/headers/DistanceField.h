@@ -0,0 +1,84 @@
+#pragma once
+#ifndef DISTANCEFIELD_H
+#define DISTANCEFIELD_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Particle.h"
+#include "Shape.h"
+
+using ::glm::mat4;
+using ::glm::vec3;
+using ::std::vector;
+
+// Sparse signed distance grid of a mesh, in mesh space. The grid is split into
+// bricks of BrickCells^3 cells; only bricks within bandCells of the surface
+// store samples, each with the distance (negative inside) and the outward
+// gradient. Bricks keep their own border samples, so a lookup is one brick
+// table read plus the 8 corners of one cell.
+// Cache layout: "PIOS", u32 version, u64 source hash, i32 resolution,
+// i32 band, vec3 origin, f32 cell size, i32 brick counts[3], then the
+// i32 brick table and the samples.
+class SignedDistanceField
+{
+public:
+	static const int BrickCells = 8;
+
+	// resolution is the cell count along the mesh's longest side
+	void bake(const vector<const Shape*>& shapes, int resolution = 64, int bandCells = 3);
+	// Reads objPath + ".sdf" if it was baked from this OBJ with these settings
+	// and is intact, otherwise bakes (in parallel) and writes it for next time
+	bool loadOrBake(const std::string& objPath, const vector<const Shape*>& shapes, int resolution = 64, int bandCells = 3);
+
+	// False outside the band, where the surface is at least the band width away
+	bool sample(const vec3& position, float& distance, vec3& gradient) const;
+
+	float getBandWidth() const { return bandCells * cellSize; }
+	size_t getBrickCount() const { return brickTable.size(); }
+	size_t getStoredBrickCount() const { return samples.size() / SamplesPerBrick; }
+
+private:
+	static const int BrickSamples = BrickCells + 1;
+	static const int SamplesPerBrick = BrickSamples * BrickSamples * BrickSamples;
+
+	struct Sample
+	{
+		float distance;
+		vec3 gradient;
+	};
+
+	bool load(const std::string& path, uint64_t sourceHash, int resolution, int bandCells);
+	bool save(const std::string& path, uint64_t sourceHash) const;
+
+	vec3 origin = vec3(0);
+	float cellSize = 1.0f;
+	int resolution = 0;
+	int bandCells = 0;
+	int bricks[3] = { 0, 0, 0 };
+	// Offset of each brick's samples in units of SamplesPerBrick, -1 if empty
+	vector<int32_t> brickTable;
+	vector<Sample> samples;
+};
+
+// A distance field placed in the world by a translate, rotate and uniform scale
+class DistanceFieldCollider
+{
+public:
+	const SignedDistanceField* field = nullptr;
+
+	void setTransform(const mat4& model, float uniformScale);
+
+	// Pushes particles closer than skin back out along the gradient, removing
+	// the inward velocity (with restitution) and damping the rest so they slide
+	void collide(const vector<Particle*>& particles, float restitution, float friction, float skin) const;
+
+private:
+	mat4 model = mat4(1.0f);
+	mat4 inverse = mat4(1.0f);
+	float scale = 1.0f;
+};
+
+#endif // DISTANCEFIELD_H
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <algorithm>
+
+// Picks a render scale for the scene pass from measured GPU time. Pixel cost
+// goes with the square of the scale, so a change aims straight for a time in
+// the middle of the band. Dropping takes a few frames over budget, raising a
+// long run under it, and nothing moves inside the band, so quality doesn't
+// oscillate. Scales snap to step so pooled targets get reused.
+class DynamicResolution
+{
+public:
+	// GPU milliseconds to hold, and the scale bounds
+	double targetMs = 12.0;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float step = 0.05f;
+	// Band around the target as fractions of it, and the frames needed to act
+	double overBudget = 1.0;
+	double underBudget = 0.8;
+	int dropAfterFrames = 3;
+	int raiseAfterFrames = 60;
+	// Weight of a new sample in the running average
+	double smoothing = 0.2;
+
+	// Feed one frame's GPU time, measured at issuedScale; returns true if the
+	// scale changed. Samples still in flight from before a change are ignored.
+	bool addSample(double gpuMs, float issuedScale);
+
+	// Within the bounds even before the first change
+	float getScale() const { return std::min(std::max(scale, minScale), maxScale); }
+	double getAverageMs() const { return average; }
+
+private:
+	float scale = 1.0f;
+	double average = 0.0;
+	int samples = 0;
+	int overFrames = 0;
+	int underFrames = 0;
+};
+
+#endif // DYNAMICRESOLUTION_H
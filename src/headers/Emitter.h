@@ -0,0 +1,76 @@
+#pragma once
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Particle.h"
+#include "ParticlePool.h"
+#include "Random.h"
+#include "Shape.h"
+
+using ::glm::mat4;
+using ::glm::vec3;
+using ::std::vector;
+
+// Spawns particles at a steady rate from a point, inside a sphere, or on the
+// surface of a mesh. Each spawn takes a fixed number of draws from one batch
+// fill, so a seeded Random gives the same particles every run.
+class Emitter
+{
+public:
+	enum Kind
+	{
+		Point,
+		Sphere,
+		MeshSurface
+	};
+
+	static Emitter point(const vec3& position);
+	static Emitter sphere(const vec3& center, float radius);
+	// Triangles of shapes placed by model, picked in proportion to their area
+	static Emitter meshSurface(const vector<const Shape*>& shapes, const mat4& model);
+
+	bool enabled = true;
+	// Particles per second; the fraction left over carries to the next step
+	float rate = 10.0f;
+	// Lifetime in seconds, drawn per particle (0 lives until culled)
+	float minLifetime = 5.0f;
+	float maxLifetime = 10.0f;
+	float minMass = 0.7f;
+	float maxMass = 1.2f;
+	// Launch speed: outward for spheres, along the normal for meshes, random for points
+	float speed = 0.05f;
+	// Random velocity added on top, per axis
+	float jitter = 0.05f;
+
+	// Spawns this step's share of the rate into live
+	size_t emit(float dt, Random& rng, ParticlePool& pool, vector<Particle*>& live);
+	// Spawns count particles now
+	size_t burst(size_t count, Random& rng, ParticlePool& pool, vector<Particle*>& live);
+
+	// Fraction of a particle owed, for checkpoints
+	float getCarry() const { return carry; }
+	void setCarry(float value) { carry = value; }
+
+private:
+	static const int DrawsPerParticle = 8;
+
+	Kind kind = Point;
+	vec3 center = vec3(0);
+	float radius = 0.0f;
+	// Mesh surface: three world space corners per triangle and the running area total
+	vector<vec3> corners;
+	vector<float> cumulativeArea;
+
+	float carry = 0.0f;
+	vector<float> draws;
+};
+
+// Runs a sphere emitter with a fixed lifetime to steady state and prints
+// spawn and kill throughput, and whether the pool still had to grow
+void benchmarkEmitters(float rate, float lifetime, int steps);
+
+#endif // EMITTER_H
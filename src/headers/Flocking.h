@@ -0,0 +1,60 @@
+#pragma once
+#ifndef FLOCKING_H
+#define FLOCKING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "NeighborGrid.h"
+#include "Particle.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+struct FlockingParams
+{
+	// Neighbours are boids within radius; also the grid cell size
+	float radius = 0.4f;
+	// Boids closer than this push apart, weighted by 1 / distance^2
+	float separationRadius = 0.15f;
+	// Cap on neighbours per boid. Each cell contributes at most this many
+	// candidates, and the search stops at the first cell that reaches it.
+	int maxNeighbors = 24;
+	float separation = 0.02f;
+	float alignment = 0.4f;
+	float cohesion = 0.3f;
+	// Longest steering force
+	float maxForce = 0.5f;
+};
+
+// Separation, alignment and cohesion steering over a uniform neighbour grid.
+// Cells are processed in parallel; the candidates of each neighbouring cell
+// are tested four at a time with SSE2 where available.
+class Flocking
+{
+public:
+	FlockingParams params;
+
+	// Steering force for each boid, in the same order as boids
+	void compute(const vector<Particle*>& boids, vector<vec3>& forces);
+	void compute(const vector<vec3>& positions, const vector<vec3>& velocities, vector<vec3>& forces);
+
+	// Candidate pairs distance-tested by the last compute
+	uint64_t getCandidateTests() const { return candidateTests; }
+
+private:
+	NeighborGrid grid;
+	// Velocities in grid order
+	vector<float> vx, vy, vz;
+	// Gathered from the particles
+	vector<vec3> positions;
+	vector<vec3> velocities;
+	uint64_t candidateTests = 0;
+};
+
+// Times grid builds and steering passes on a synthetic flock and prints
+// neighbour queries (boids answered) and candidate tests per second
+void benchmarkFlocking(size_t count, int steps);
+
+#endif // FLOCKING_H
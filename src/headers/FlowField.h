@@ -0,0 +1,85 @@
+#pragma once
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Divergence-free velocity field from the curl of a 3D noise potential, baked
+// into a resolution^3 grid over a cube and read back with trilinear lookup.
+// A background thread bakes the next generation slab by slab while the current
+// one is sampled. Generations swap every refreshInterval steps, so a replay
+// sees the same field no matter how fast the thread ran.
+class CurlNoiseGrid
+{
+public:
+	~CurlNoiseGrid();
+
+	// Bakes the field for step 0 and starts the builder thread
+	void init(vec3 center, float halfExtent, int resolution, uint32_t seed);
+	// Call once per simulation step; may wait on the builder at a swap
+	void advance(uint32_t step);
+	// Rebakes for an arbitrary step, e.g. after loading a checkpoint
+	void reset(uint32_t step);
+	// Stops and joins the builder thread
+	void shutdown();
+
+	bool isReady() const { return !current.empty(); }
+
+	// Velocity at position, clamped to the grid edge outside the cube
+	vec3 sample(const vec3& position) const
+	{
+		vec3 g = glm::clamp((position - origin) * inverseSpacing, vec3(0), vec3((float) (resolution - 1) - 0.001f));
+		int x = (int) g.x, y = (int) g.y, z = (int) g.z;
+		vec3 f = g - vec3(x, y, z);
+
+		const vec3* c = &current[(z * resolution + y) * resolution + x];
+		const int dy = resolution, dz = resolution * resolution;
+		vec3 c00 = glm::mix(c[0], c[1], f.x);
+		vec3 c10 = glm::mix(c[dy], c[dy + 1], f.x);
+		vec3 c01 = glm::mix(c[dz], c[dz + 1], f.x);
+		vec3 c11 = glm::mix(c[dz + dy], c[dz + dy + 1], f.x);
+		return glm::mix(glm::mix(c00, c10, f.y), glm::mix(c01, c11, f.y), f.z);
+	}
+
+	// Steps between generations
+	uint32_t refreshInterval = 50;
+	// Noise features per world unit, and how far the noise drifts per generation
+	float frequency = 0.6f;
+	float drift = 0.15f;
+
+private:
+	void builderLoop();
+	// Bakes one z slab of a generation into out
+	void bakeSlab(uint32_t generation, int z, vector<vec3>& out) const;
+	void requestGeneration(uint32_t generation);
+
+	vec3 origin = vec3(0);
+	float spacing = 1.0f;
+	float inverseSpacing = 1.0f;
+	int resolution = 0;
+	uint32_t seed = 0;
+
+	// Sim thread only
+	vector<vec3> current;
+	uint32_t currentGeneration = 0;
+
+	// Owned by the builder until nextReady
+	vector<vec3> next;
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable changed;
+	uint32_t requested = 0;
+	bool nextReady = false;
+	bool stopping = false;
+};
+
+#endif // FLOWFIELD_H
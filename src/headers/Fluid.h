@@ -0,0 +1,50 @@
+#pragma once
+#ifndef FLUID_H
+#define FLUID_H
+
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "NeighborGrid.h"
+#include "Particle.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+struct SphParams
+{
+	// Kernel support radius h, also the grid cell size
+	float smoothingRadius = 0.3f;
+	// Density the pressure pushes towards (mass per cubic unit)
+	float restDensity = 150.0f;
+	// Pressure per unit of excess density; kept soft enough for dtime = 0.1
+	float stiffness = 0.02f;
+	float viscosity = 0.5f;
+};
+
+// Smoothed particle hydrodynamics over a set of particles: poly6 density,
+// spiky pressure gradient and viscosity Laplacian (Mueller et al. 2003).
+// Particles are sorted into a cell list; the density and force passes each
+// run a cell per task on the shared thread pool.
+class SphFluid
+{
+public:
+	SphParams params;
+
+	// Pressure and viscosity force for each particle, in the same order
+	void compute(const vector<Particle*>& particles, vector<vec3>& forces);
+
+	// Densities from the last compute, in grid order
+	const vector<float>& getDensities() const { return density; }
+
+private:
+	NeighborGrid grid;
+	vector<vec3> positions;
+	// Per-particle columns in grid order
+	vector<float> vx, vy, vz;
+	vector<float> mass;
+	vector<float> density;
+	vector<float> pressure;
+};
+
+#endif // FLUID_H
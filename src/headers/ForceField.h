@@ -0,0 +1,197 @@
+#pragma once
+#ifndef FORCEFIELD_H
+#define FORCEFIELD_H
+
+#include <cmath>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "FlowField.h"
+#include "Particle.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Force fields are plain structs with an inline
+//   void accumulate(const Particle& p, size_t i, vec3& force) const
+// where i is the particle's index for per-particle inputs (random draws).
+// A ForcePipeline of fields is expanded at compile time into one function, so
+// a single loop over the particles evaluates every field with no virtual calls.
+
+// Same force everywhere (gravity, wind)
+struct UniformField
+{
+	bool enabled = false;
+	vec3 force = vec3(0);
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (enabled) out += force;
+	}
+};
+
+// Spring-like pull toward a point, growing with distance. randomScale, when set,
+// holds one multiplier per particle.
+struct PointField
+{
+	bool enabled = false;
+	vec3 center = vec3(0);
+	// Distance at which the pull equals strength times the offset
+	float distanceScale = 1.0f;
+	float strength = 1.0f;
+	const float* randomScale = nullptr;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (!enabled) return;
+		vec3 towards = center - p.position;
+		float distance = glm::length(towards) / distanceScale;
+		float scale = randomScale ? randomScale[i] : strength;
+		out += distance * scale * towards;
+	}
+};
+
+// Push away from each source inside radius. falloff 0 is a hard cutoff,
+// higher values fade the push out towards the edge.
+struct RadialFalloffField
+{
+	bool enabled = false;
+	const vector<vec3>* sources = nullptr;
+	float radius = 1.0f;
+	float strength = 1.0f;
+	float falloff = 0.0f;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (!enabled || !sources) return;
+		for (const vec3& source : *sources) {
+			vec3 away = p.position - source;
+			float distance = glm::length(away);
+			if (distance >= radius) continue;
+			if (falloff == 0.0f) {
+				out += strength == 1.0f ? away : strength * away;
+			}
+			else {
+				out += strength * std::pow(1.0f - distance / radius, falloff) * away;
+			}
+		}
+	}
+};
+
+// Swirl around an axis through center, fading with distance from the axis
+struct VortexField
+{
+	bool enabled = false;
+	vec3 center = vec3(0);
+	vec3 axis = vec3(0, 1, 0);
+	float strength = 1.0f;
+	float radius = 1.0f;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (!enabled) return;
+		vec3 offset = p.position - center;
+		vec3 tangent = glm::cross(axis, offset);
+		float distance = glm::length(offset - glm::dot(offset, axis) * axis);
+		if (distance < radius) out += strength * (1.0f - distance / radius) * tangent;
+	}
+};
+
+// Per-particle random push, three values per particle from a batch fill
+struct NoiseField
+{
+	bool enabled = false;
+	const float* draws = nullptr;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (enabled && draws) out += vec3(draws[3 * i + 0], draws[3 * i + 1], draws[3 * i + 2]);
+	}
+};
+
+// Steers velocity toward a baked flow field: a few loads per particle for the
+// trilinear lookup, no noise evaluated at run time
+struct FlowGridField
+{
+	bool enabled = false;
+	const CurlNoiseGrid* grid = nullptr;
+	// Flow speed in world units per second, and how quickly particles follow it
+	float speed = 1.0f;
+	float response = 1.0f;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (enabled && grid) out += p.mass * response * (speed * grid->sample(p.position) - p.velocity);
+	}
+};
+
+// Per-particle force computed before the step (e.g. flocking), held for the whole step
+struct PrecomputedField
+{
+	bool enabled = false;
+	const vec3* forces = nullptr;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (enabled && forces) out += forces[i];
+	}
+};
+
+// Linear drag against velocity
+struct DragField
+{
+	bool enabled = false;
+	float coefficient = 0.0f;
+
+	void accumulate(const Particle& p, size_t i, vec3& out) const
+	{
+		if (enabled) out -= coefficient * p.velocity;
+	}
+};
+
+template <typename... Fields>
+class ForcePipeline
+{
+public:
+	std::tuple<Fields...> fields;
+
+	template <size_t I>
+	typename std::tuple_element<I, std::tuple<Fields...> >::type& get()
+	{
+		return std::get<I>(fields);
+	}
+
+	// Sum of every field in declaration order (same rounding as adding them one by one)
+	vec3 evaluate(const Particle& p, size_t i) const
+	{
+		vec3 force(0);
+		accumulate<0>(p, i, force);
+		return force;
+	}
+
+	// Convenience single pass that adds the fields to each particle's forces
+	void apply(const vector<Particle*>& particles) const
+	{
+		for (size_t i = 0; i < particles.size(); i++) {
+			particles[i]->addForce(evaluate(*particles[i], i));
+		}
+	}
+
+private:
+	template <size_t I>
+	typename std::enable_if<(I == sizeof...(Fields))>::type accumulate(const Particle& p, size_t i, vec3& force) const
+	{
+	}
+
+	template <size_t I>
+	typename std::enable_if<(I < sizeof...(Fields))>::type accumulate(const Particle& p, size_t i, vec3& force) const
+	{
+		std::get<I>(fields).accumulate(p, i, force);
+		accumulate<I + 1>(p, i, force);
+	}
+};
+
+#endif // FORCEFIELD_H
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/gtc/type_ptr.hpp>
+
+using ::glm::vec3;
+using ::glm::vec4;
+using ::glm::mat4;
+
+// View frustum as six inward-facing planes, extracted from a projection * view matrix
+class Frustum
+{
+public:
+	void extract(const mat4& viewProjection);
+
+	// True if any part of the sphere is inside (world space)
+	bool containsSphere(const vec3& center, float radius) const;
+	// True if any part of the model-space box is inside once transformed by model
+	bool containsBox(const vec3& min, const vec3& max, const mat4& model) const;
+
+private:
+	vec4 planes[6];
+};
+
+#endif // FRUSTUM_H
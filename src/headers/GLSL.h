@@ -24,13 +24,40 @@ namespace GLSL
 	void enableVertexAttribArray(const GLint handle);
 	void disableVertexAttribArray(const GLint handle);
 	void vertexAttribPointer(const GLint handle, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+
+	// Installs a KHR_debug message callback (needs a current context). Returns false
+	// if the extension is missing, in which case CHECKED_GL_CALL keeps polling glGetError.
+	bool enableDebugOutput();
+
+	// Most recent CHECKED_GL_CALL site, reported by the debug callback. Messages are
+	// asynchronous, so the site is the last call issued, not necessarily the culprit.
+	// A plain global, not thread_local, since the driver may call back on its own
+	// thread: CHECKED_GL_CALL is for the GL context's thread only, and code that
+	// runs elsewhere (such as building render commands) must not use it.
+	struct CallSite
+	{
+		const char *function;
+		const char *file;
+		int line;
+	};
+	extern CallSite lastCallSite;
+	extern bool debugOutputEnabled;
 }
 
 
-#ifndef DISABLE_OPENGL_ERROR_CHECKS
-#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
-#else
+// Release builds (NDEBUG) compile the checks away entirely. With OPENGL_DEBUG_OUTPUT
+// errors come from the driver's debug callback and a call only records its site,
+// so nothing forces a glGetError round trip per call.
+#if defined(DISABLE_OPENGL_ERROR_CHECKS) || defined(NDEBUG)
 #define CHECKED_GL_CALL(x) (x)
+#elif defined(OPENGL_DEBUG_OUTPUT)
+#define CHECKED_GL_CALL(x) do { \
+	GLSL::lastCallSite.function = #x; GLSL::lastCallSite.file = __FILE__; GLSL::lastCallSite.line = __LINE__; \
+	if (GLSL::debugOutputEnabled) { (x); } \
+	else { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } \
+} while (0)
+#else
+#define CHECKED_GL_CALL(x) do { GLSL::printOpenGLErrors("{{BEFORE}} "#x, __FILE__, __LINE__); (x); GLSL::printOpenGLErrors(#x, __FILE__, __LINE__); } while (0)
 #endif
 
 #ifndef M_PI
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef GPUPARTICLESYSTEM_H
+#define GPUPARTICLESYSTEM_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Program.h"
+#include "Shape.h"
+
+using ::glm::vec3;
+using ::glm::mat4;
+using ::std::vector;
+
+#define MAX_GPU_MAGNETS 64
+
+// Per-particle state as laid out in the simulation buffers
+struct GpuParticle
+{
+	vec3 position;
+	float mass;
+	vec3 velocity;
+	float seed;
+};
+
+// Inputs to one simulation step, mirroring the CPU toggles
+struct GpuSimParams
+{
+	float dt;
+	bool isGravityOn;
+	bool isCenterPointAttractive;
+	vec3 centerPoint;
+	float domainHalfExtent;
+	vector<vec3> magnets;
+};
+
+// Keeps particle state in two buffer objects and advances it with a transform
+// feedback vertex shader (GL 3.3 core). The instanced renderer and the scene
+// lighting read the latest buffer directly, so nothing comes back to the CPU.
+class GpuParticleSystem
+{
+public:
+	GpuParticleSystem(int capacity);
+
+	// mesh is drawn once per particle
+	bool init(const std::string& resourceDirectory, const Shape* mesh);
+
+	// Queued and uploaded on the next step; overwrites the oldest slot when full
+	void spawn(float mass, vec3 position, vec3 velocity);
+	void clear();
+	void step(const GpuSimParams& params);
+
+	// Instanced draw with the particle program; P and V as in the scene pass
+	void draw(const mat4& P, const mat4& V, float particleScale);
+	// Bind the current state as a samplerBuffer (two RGBA32F texels per particle)
+	void bindStateTexture(GLenum textureUnit) const;
+
+	// Slots in use (live or retired in place)
+	int getCount() const { return count; }
+	int getCapacity() const { return capacity; }
+	// First of the newest window slots in the ring; they run on from there,
+	// wrapping at getCapacity(). Older slots are the likeliest to be dead.
+	int getNewestSlot(int window) const { return (nextSlot - std::min(window, count) + capacity) % capacity; }
+	// Buffer holding the latest step, GpuParticle per slot
+	GLuint getStateBuffer() const { return stateBufID[current]; }
+
+private:
+	void uploadPending();
+
+	int capacity;
+	int count = 0;
+	int nextSlot = 0;
+	unsigned int frame = 0;
+	unsigned int nextSeed = 1;
+	vector<GpuParticle> pending;
+
+	// Ping-pong state, index current holds the latest step
+	int current = 0;
+	GLuint stateBufID[2];
+	GLuint stateTexID[2];
+	GLuint updateVaoID[2];
+	GLuint drawVaoID[2];
+
+	GLuint meshBufID = 0;
+	GLuint meshEleBufID = 0;
+	GLsizei meshIndexCount = 0;
+
+	Program* updateProgram = nullptr;
+	Program* drawProgram = nullptr;
+};
+
+#endif // GPUPARTICLESYSTEM_H
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <vector>
+#include <glad/glad.h>
+
+using ::std::vector;
+
+// GPU time between begin() and end(), from GL_TIME_ELAPSED queries kept in a
+// small ring. Results are read a few frames late, once available, so polling
+// never stalls the pipeline. Frames that find the ring full go unmeasured.
+class GpuTimer
+{
+public:
+	bool init(int depth = 4);
+
+	// tag rides along with the measurement, e.g. the setting it was taken at
+	void begin(float tag = 0.0f);
+	void end();
+	// Oldest finished measurement in milliseconds, false if none is ready yet
+	bool poll(double& milliseconds);
+	// Same, with the tag its begin() was given
+	bool poll(double& milliseconds, float& tag);
+
+private:
+	vector<GLuint> queries;
+	vector<float> tags;
+	// Next query to start, oldest unread one, and how many are waiting
+	int head = 0;
+	int tail = 0;
+	int pending = 0;
+	bool running = false;
+};
+
+#endif // GPUTIMER_H
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using ::std::vector;
+
+// Simulation-affecting input, applied at the start of a sim step
+struct InputEvent
+{
+	enum Type : uint8_t
+	{
+		SpawnFireflies = 0,
+		PlaceMagnet = 1,
+		ToggleGravity = 2,
+		ToggleCenterAttraction = 3,
+		ClearParticles = 4,
+		ToggleFlocking = 5,
+		ToggleFluid = 6,
+		ToggleEmitters = 7,
+		// Written once on close, step is the total number of steps run
+		End = 255
+	};
+
+	uint32_t step;
+	uint8_t type;
+	// World space x, y for spawns and magnets
+	float x;
+	float y;
+};
+
+// Options that change the simulation, which a replay has to run with too
+struct RunSettings
+{
+	// IntegratorType, as its underlying value
+	uint8_t integrator = 0;
+	float dt = 0.0f;
+	bool allowSleep = true;
+	bool gpuSimulation = false;
+};
+
+// Streams input events, the RNG seed and run settings to a compact binary log.
+// Layout: "PIOR", u32 version, u64 seed, u8 integrator, f32 dt, u8 allowSleep,
+// u8 gpuSimulation, then 13 byte records (u32 step, u8 type, f32 x, f32 y),
+// all little endian as written by the host.
+class InputRecorder
+{
+public:
+	bool open(const std::string& path, uint64_t seed, const RunSettings& settings);
+	void record(const InputEvent& event);
+	// Writes the End record and closes the file
+	void close(uint32_t finalStep);
+
+private:
+	std::ofstream file;
+};
+
+// Loads a log written by InputRecorder and hands events back step by step
+class InputReplay
+{
+public:
+	bool load(const std::string& path);
+
+	uint64_t getSeed() const { return seed; }
+	const RunSettings& getSettings() const { return settings; }
+	// Number of steps the recorded session ran
+	uint32_t getEndStep() const { return endStep; }
+
+	// Next event due at step, false once none are left for it
+	bool next(uint32_t step, InputEvent& event);
+
+private:
+	uint64_t seed = 0;
+	RunSettings settings;
+	uint32_t endStep = 0;
+	vector<InputEvent> events;
+	size_t cursor = 0;
+};
+
+#endif // INPUTLOG_H
@@ -0,0 +1,156 @@
+#pragma once
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Particle.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Integrator policies advance one particle by dt. Forces is anything with
+//   vec3 evaluate(const Particle& p, size_t i) const
+// (e.g. a ForcePipeline) and is re-evaluated at intermediate states as needed.
+// Each policy leaves the last force it evaluated in p.forces.
+
+// v += a dt, then x += v dt. One force evaluation, first order, symplectic.
+struct SymplecticEuler
+{
+	static const char* name() { return "symplectic-euler"; }
+
+	template <typename Forces>
+	static void step(Particle& p, size_t i, float dt, const Forces& forces)
+	{
+		p.forces = forces.evaluate(p, i);
+		p.velocity += p.forces / p.mass * dt;
+		p.position += p.velocity * dt;
+	}
+};
+
+// Second order and symplectic for position-only forces. Velocity dependent
+// forces see an Euler predicted velocity at the end of the step.
+struct VelocityVerlet
+{
+	static const char* name() { return "velocity-verlet"; }
+
+	template <typename Forces>
+	static void step(Particle& p, size_t i, float dt, const Forces& forces)
+	{
+		vec3 a0 = forces.evaluate(p, i) / p.mass;
+		p.position += p.velocity * dt + 0.5f * a0 * dt * dt;
+
+		Particle predicted = p;
+		predicted.velocity = p.velocity + a0 * dt;
+		p.forces = forces.evaluate(predicted, i);
+		vec3 a1 = p.forces / p.mass;
+		p.velocity += 0.5f * (a0 + a1) * dt;
+	}
+};
+
+// Classic fourth order Runge-Kutta on (position, velocity), four evaluations
+struct RungeKutta4
+{
+	static const char* name() { return "rk4"; }
+
+	template <typename Forces>
+	static void step(Particle& p, size_t i, float dt, const Forces& forces)
+	{
+		Particle s = p;
+
+		vec3 k1x = p.velocity;
+		vec3 k1v = forces.evaluate(p, i) / p.mass;
+
+		s.position = p.position + k1x * (0.5f * dt);
+		s.velocity = p.velocity + k1v * (0.5f * dt);
+		vec3 k2x = s.velocity;
+		vec3 k2v = forces.evaluate(s, i) / p.mass;
+
+		s.position = p.position + k2x * (0.5f * dt);
+		s.velocity = p.velocity + k2v * (0.5f * dt);
+		vec3 k3x = s.velocity;
+		vec3 k3v = forces.evaluate(s, i) / p.mass;
+
+		s.position = p.position + k3x * dt;
+		s.velocity = p.velocity + k3v * dt;
+		vec3 k4x = s.velocity;
+		p.forces = forces.evaluate(s, i);
+		vec3 k4v = p.forces / p.mass;
+
+		p.position += (k1x + 2.0f * k2x + 2.0f * k3x + k4x) * (dt / 6.0f);
+		p.velocity += (k1v + 2.0f * k2v + 2.0f * k3v + k4v) * (dt / 6.0f);
+	}
+};
+
+// Splits the step so no substep changes velocity by more than MaxDeltaV,
+// judged from the acceleration at the start of the step
+template <typename Base, int MaxSubsteps = 8>
+struct AdaptiveSubsteps
+{
+	static const char* name() { return "adaptive"; }
+	// Largest velocity change per substep, in world units per second
+	static float maxDeltaV() { return 0.05f; }
+
+	template <typename Forces>
+	static void step(Particle& p, size_t i, float dt, const Forces& forces)
+	{
+		float accel = glm::length(forces.evaluate(p, i)) / p.mass;
+		int substeps = (int) std::ceil(accel * dt / maxDeltaV());
+		substeps = std::min(std::max(substeps, 1), MaxSubsteps);
+
+		float h = dt / substeps;
+		for (int s = 0; s < substeps; s++) {
+			Base::step(p, i, h, forces);
+		}
+	}
+};
+
+// Runtime choice, dispatched once per step to the matching template
+enum class IntegratorType
+{
+	SymplecticEuler,
+	VelocityVerlet,
+	RungeKutta4,
+	Adaptive
+};
+
+// Accepts the policy names above; returns false for anything else
+bool parseIntegratorType(const std::string& name, IntegratorType& type);
+const char* integratorName(IntegratorType type);
+
+// Runs every integrator on a conservative copy of the firefly forces (center
+// pull, gravity, hard-edged magnet push) and prints energy drift and cost
+void benchmarkIntegrators(float dt, int steps);
+
+template <typename Integrator, typename Forces>
+void integrateParticles(const vector<Particle*>& particles, float dt, const Forces& forces)
+{
+	for (size_t i = 0; i < particles.size(); i++) {
+		Integrator::step(*particles[i], i, dt, forces);
+	}
+}
+
+template <typename Forces>
+void integrateParticles(IntegratorType type, const vector<Particle*>& particles, float dt, const Forces& forces)
+{
+	switch (type) {
+		case IntegratorType::SymplecticEuler:
+			integrateParticles<SymplecticEuler>(particles, dt, forces);
+			break;
+		case IntegratorType::VelocityVerlet:
+			integrateParticles<VelocityVerlet>(particles, dt, forces);
+			break;
+		case IntegratorType::RungeKutta4:
+			integrateParticles<RungeKutta4>(particles, dt, forces);
+			break;
+		case IntegratorType::Adaptive:
+			integrateParticles<AdaptiveSubsteps<VelocityVerlet> >(particles, dt, forces);
+			break;
+	}
+}
+
+#endif // INTEGRATOR_H
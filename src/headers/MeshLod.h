@@ -0,0 +1,53 @@
+#pragma once
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Shape.h"
+
+using ::glm::mat4;
+using ::glm::vec3;
+using ::std::vector;
+
+// Quadric error edge collapse (Garland and Heckbert) of an indexed triangle
+// mesh down to about targetTriangles. Vertices are welded by position first,
+// collapses that would flip a face are skipped, and the output gets smooth
+// normals. Texture coordinates are dropped.
+bool simplifyMesh(const vector<float>& positions, const vector<unsigned int>& indices, size_t targetTriangles,
+	vector<float>& outPositions, vector<float>& outNormals, vector<unsigned int>& outIndices);
+
+// A mesh plus coarser copies of it, one picked per instance by how many pixels
+// the instance covers on screen. Below the last level a camera-facing
+// billboard stands in. Levels are GL Shapes, so build on the GL thread.
+class MeshLod
+{
+public:
+	~MeshLod();
+
+	// Level 0 is source itself (not owned); each ratio adds a simplified copy
+	// with that fraction of its triangles, drawn down to the matching minPixels
+	void build(const Shape* source, const vector<float>& ratios, const vector<float>& minPixels);
+	// Drawn below the last level's minPixels; billboard spans -1..1 in x and y
+	void setBillboard(const Shape* billboard) { this->billboard = billboard; }
+
+	// Level for an instance covering pixels, getLevelCount() means the billboard
+	int select(float pixels) const;
+	int getLevelCount() const { return (int) levels.size(); }
+	const Shape* getShape(int level) const { return level < (int) levels.size() ? levels[level] : billboard; }
+	bool isBillboard(int level) const { return level >= (int) levels.size(); }
+	size_t getTriangleCount(int level) const;
+
+	// Screen height in pixels of a sphere of radius at viewPosition (view space)
+	static float projectedPixels(const mat4& P, const vec3& viewPosition, float radius, int viewportHeight);
+
+private:
+	vector<const Shape*> levels;
+	vector<Shape*> owned;
+	vector<float> minPixels;
+	const Shape* billboard = nullptr;
+};
+
+#endif // MESHLOD_H
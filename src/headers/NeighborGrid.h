@@ -0,0 +1,57 @@
+#pragma once
+#ifndef NEIGHBORGRID_H
+#define NEIGHBORGRID_H
+
+#include <cstdint>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Uniform grid over the bounding box of a point set, built with a counting
+// sort. Points are stored by cell in structure-of-arrays form, so the points
+// of one cell are contiguous in x/y/z (and any column gathered with order).
+// Cells are at least cellSize wide; with cellSize equal to the query radius,
+// every neighbour lies in the 3x3x3 block around a point's cell.
+class NeighborGrid
+{
+public:
+	// maxCells caps memory for sparse, spread out point sets by widening the cells
+	void build(const vec3* positions, size_t count, float cellSize, size_t maxCells = 1 << 21);
+
+	// Copies values[order[k]] to out[k], putting a per-point column in cell order
+	template <typename T>
+	void gather(const T* values, vector<T>& out) const
+	{
+		out.resize(order.size());
+		for (size_t k = 0; k < order.size(); k++) out[k] = values[order[k]];
+	}
+
+	int cellIndex(int cx, int cy, int cz) const { return (cz * dims[1] + cy) * dims[0] + cx; }
+	// Cell coordinates of a point, clamped to the grid
+	void cellOf(const vec3& position, int& cx, int& cy, int& cz) const;
+	// Sorted ranges of the non-empty cells in the 3x3x3 block around cell,
+	// the cell itself first. Returns how many of the 27 slots were filled.
+	int neighborRanges(size_t cell, size_t* begin, size_t* end) const;
+
+	int getCellCount() const { return dims[0] * dims[1] * dims[2]; }
+	const int* getDims() const { return dims; }
+	float getCellSize() const { return cellSize; }
+
+	// Sorted points of cell c are [cellStart[c], cellStart[c + 1])
+	vector<uint32_t> cellStart;
+	// Original index of each sorted point
+	vector<uint32_t> order;
+	// Sorted positions
+	vector<float> x, y, z;
+
+private:
+	vec3 origin = vec3(0);
+	float cellSize = 1.0f;
+	float inverseCellSize = 1.0f;
+	int dims[3] = { 1, 1, 1 };
+	vector<uint32_t> pointCell;
+};
+
+#endif // NEIGHBORGRID_H
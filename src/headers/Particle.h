@@ -13,6 +13,11 @@ public:
 	vec3 position;
 	vec3 velocity;
 	vec3 forces;
+	// Seconds since spawn, and how long to live (0 lives until culled)
+	float age = 0.0f;
+	float lifetime = 0.0f;
+	// Consecutive steps spent under the sleep thresholds
+	int restSteps = 0;
 
 	Particle(float m, vec3 x, vec3 v, vec3 f);
 	virtual ~Particle();
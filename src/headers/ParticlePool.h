@@ -0,0 +1,57 @@
+#pragma once
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Particle.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Particles carved out of fixed-size blocks and recycled through a free list,
+// so a steady stream of spawns and deaths never reaches the allocator
+class ParticlePool
+{
+public:
+	explicit ParticlePool(size_t blockSize = 4096);
+	~ParticlePool();
+
+	Particle* acquire(float mass, const vec3& position, const vec3& velocity);
+	void release(Particle* p);
+	// Makes sure count more particles can be acquired without growing
+	void reserve(size_t count);
+
+	// Releases every particle of live that dead(p) accepts, closing the gaps
+	// in one pass so the survivors stay dense and in order
+	template <typename Dead>
+	size_t releaseIf(vector<Particle*>& live, Dead dead)
+	{
+		size_t alive = 0;
+		for (size_t i = 0; i < live.size(); i++) {
+			if (dead(live[i])) {
+				release(live[i]);
+			}
+			else {
+				live[alive++] = live[i];
+			}
+		}
+		size_t released = live.size() - alive;
+		live.resize(alive);
+		return released;
+	}
+
+	// Particles ever carved, live or free
+	size_t getCapacity() const { return blocks.size() * blockSize; }
+
+private:
+	void grow();
+
+	size_t blockSize;
+	vector<Particle*> blocks;
+	vector<Particle*> freeList;
+};
+
+#endif // PARTICLEPOOL_H
@@ -4,6 +4,7 @@
 
 #include <map>
 #include <string>
+#include <vector>
 
 #include <glad/glad.h>
 
@@ -18,6 +19,8 @@ public:
 	bool isVerbose() const { return verbose; }
 
 	void setShaderNames(const std::string &v, const std::string &f);
+	// Captured vertex outputs for transform feedback (interleaved), set before init()
+	void setTransformFeedbackVaryings(const std::vector<std::string> &names) { feedbackVaryings = names; }
 	virtual bool init();
 	virtual void bind();
 	virtual void unbind();
@@ -26,11 +29,13 @@ public:
 	void addUniform(const std::string &name);
 	GLint getAttribute(const std::string &name) const;
 	GLint getUniform(const std::string &name) const;
+	GLuint getPID() const { return pid; }
 
 protected:
 
 	std::string vShaderName;
 	std::string fShaderName;
+	std::vector<std::string> feedbackVaryings;
 
 private:
 
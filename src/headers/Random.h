@@ -0,0 +1,53 @@
+#pragma once
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstddef>
+#include <cstdint>
+
+// xoshiro128+ generator, four lanes wide so batches can be filled with SIMD.
+// Each lane is an independent stream; scalar and SIMD paths produce the same
+// numbers, so a seed replays exactly on any build.
+class Random
+{
+public:
+	explicit Random(uint64_t seed = 1);
+
+	// Expands the seed with splitmix64, stream selects an independent sequence
+	void seed(uint64_t seed, uint64_t stream = 0);
+
+	uint32_t nextUInt();
+	// Uniform in [0, 1), 24 bits of precision
+	float nextFloat();
+	// Uniform in [lowBound, highBound)
+	float nextFloat(float lowBound, float highBound);
+
+	// Fills out[0..count) with uniform floats in [lowBound, highBound)
+	void fill(float* out, size_t count, float lowBound, float highBound);
+
+	// Raw generator state, for checkpoints and replay
+	struct State
+	{
+		uint32_t s[4][4];
+		uint32_t buffered[4];
+		uint32_t lane;
+	};
+	State getState() const;
+	void setState(const State& state);
+
+	// Run seed, for anything derived from it outside a generator (such as the flow field)
+	static void setGlobalSeed(uint64_t seed);
+	static uint64_t getGlobalSeed();
+
+private:
+	// s[word][lane]
+	uint32_t s[4][4];
+	// Lane the scalar calls draw from next
+	uint32_t lane = 0;
+	// Leftover values of the last 4-wide step for scalar calls
+	uint32_t buffered[4];
+
+	void advance(uint32_t out[4]);
+};
+
+#endif // RANDOM_H
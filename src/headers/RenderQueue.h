@@ -0,0 +1,109 @@
+#pragma once
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Program.h"
+#include "Shape.h"
+#include "StaticBatch.h"
+#include "Texture.h"
+
+using ::glm::vec3;
+using ::glm::mat4;
+using ::std::vector;
+
+// Per-draw surface parameters for the scene shader
+struct Material
+{
+	vec3 color;
+	float shininess;
+	bool isLightSource;
+	bool isGlobeSphere;
+};
+
+// A single recorded draw. Commands are plain data and make no GL calls, so they
+// can be built on any thread and handed to the queue. Either shape is set, or
+// batch and batchGroup name one material group of a static batch.
+struct DrawCommand
+{
+	uint64_t key;
+	Program* program;
+	Texture* texture;
+	int materialId;
+	const Shape* shape;
+	const StaticBatch* batch;
+	int batchGroup;
+	mat4 model;
+};
+
+// Collects draws for a frame, sorts them by program, texture and material, and
+// issues them with redundant binds and uniform writes filtered out.
+class RenderQueue
+{
+public:
+	// Register a material before recording; returns its id
+	int addMaterial(const Material& material);
+	const Material& getMaterial(int id) const { return materials[id]; }
+
+	// Build a command without queueing it (safe off the GL thread)
+	DrawCommand makeCommand(Program* prog, Texture* tex, int materialId, const Shape* shape, const mat4& model) const;
+
+	// Thread-safe submission, single command or a whole recorded batch
+	void submit(Program* prog, Texture* tex, int materialId, const Shape* shape, const mat4& model);
+	void submit(const vector<DrawCommand>& batch);
+	// One command per material group of the batch; tex applies to groups whose
+	// material samples it (isGlobeSphere)
+	void submit(Program* prog, Texture* tex, const StaticBatch* batch, const mat4& model);
+
+	// GL thread only: sort, draw and clear the queue
+	void flush();
+	// GL thread only: draw what is queued with prog, already bound with its P
+	// and V set, writing only M per draw. Leaves the queue for flush(), e.g.
+	// to lay down depth before the shaded pass.
+	void drawDepth(Program* prog);
+
+	// Counters from the last flush
+	int getDrawCount() const { return drawCount; }
+	int getStateChanges() const { return stateChanges; }
+	int getSkippedWrites() const { return skippedWrites; }
+
+private:
+	// Key layout (high to low): program 16 | texture 16 | material 16 | unused 16.
+	// Submission order breaks ties since the sort is stable.
+	static uint64_t makeKey(const Program* prog, const Texture* tex, int materialId);
+
+	// Uniform locations of the currently bound program
+	struct Locations
+	{
+		GLint M;
+		GLint shapeColor;
+		GLint shininess;
+		GLint isLightSource;
+		GLint isGlobeSphere;
+		GLint texture;
+	};
+	void bindProgram(Program* prog);
+	void applyMaterial(const Material& material);
+
+	std::mutex submitLock;
+	vector<DrawCommand> commands;
+	vector<Material> materials;
+
+	// Shadowed GL state, reset on every flush
+	Program* boundProgram = nullptr;
+	Texture* boundTexture = nullptr;
+	Locations loc;
+	bool haveMaterial = false;
+	Material lastMaterial;
+
+	int drawCount = 0;
+	int stateChanges = 0;
+	int skippedWrites = 0;
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+using ::std::vector;
+
+// Transient render targets (2D textures and depth renderbuffers) handed out
+// per frame. A released target is reused by the next acquire with the same
+// size and format, so steady frames allocate nothing; targets left unused for
+// a few frames (e.g. the old size after a resize) are deleted at endFrame.
+class RenderTargetPool
+{
+public:
+	~RenderTargetPool();
+
+	// Linear filtered, edge clamped color texture
+	GLuint acquireTexture(int width, int height, GLenum internalFormat);
+	GLuint acquireDepth(int width, int height);
+	// Nearest filtered depth texture, for passes that read depth back
+	GLuint acquireDepthTexture(int width, int height);
+	// Either kind, back to the pool for reuse
+	void release(GLuint id);
+	void releaseAll();
+
+	// Deletes free targets unused for more than maxIdleFrames
+	void endFrame(uint32_t maxIdleFrames = 3);
+
+	// Estimated video memory of every target the pool holds, and of those in use
+	size_t getBytesAllocated() const;
+	size_t getBytesInUse() const;
+	size_t getTargetCount() const { return entries.size(); }
+
+	// Estimated storage per texel; drivers pad some formats (RGB16F to RGBA16F)
+	static size_t bytesPerTexel(GLenum internalFormat);
+	// Whether a texture of internalFormat makes a complete color attachment
+	static bool isColorRenderable(GLenum internalFormat);
+
+private:
+	struct Entry
+	{
+		GLuint id;
+		bool isRenderbuffer;
+		int width;
+		int height;
+		GLenum internalFormat;
+		bool inUse;
+		uint32_t lastUsedFrame;
+	};
+
+	GLuint acquire(int width, int height, GLenum internalFormat, bool isRenderbuffer);
+	static void destroy(const Entry& entry);
+
+	vector<Entry> entries;
+	uint32_t frame = 0;
+};
+
+// Color target formats by name (rgb16f, r11f_g11f_b10f, ...) and back
+bool parseColorFormat(const std::string& name, GLenum& format);
+const char* colorFormatName(GLenum format);
+
+#endif // RENDERTARGETPOOL_H
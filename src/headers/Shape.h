@@ -21,6 +21,12 @@ public:
 	void measure();
 	void draw(const Program *prog) const;
 
+	// CPU copies of the mesh, used for batching and collision
+	const vector<float>& getPositions() const { return posBuf; }
+	const vector<float>& getNormals() const { return norBuf; }
+	const vector<float>& getTexCoords() const { return texBuf; }
+	const vector<unsigned int>& getIndices() const { return eleBuf; }
+
 	vec3 min = vec3(0);
 	vec3 max = vec3(0);
 
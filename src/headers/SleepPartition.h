@@ -0,0 +1,82 @@
+#pragma once
+#ifndef SLEEPPARTITION_H
+#define SLEEPPARTITION_H
+
+#include <cstddef>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Particle.h"
+#include "ParticlePool.h"
+
+using ::glm::vec3;
+using ::std::vector;
+
+// Parks particles that have come to rest in a list of their own, so a step
+// only integrates the ones still moving. A particle sleeps once its speed and
+// the net force of its last step have stayed under the thresholds for
+// sleepAfterSteps steps in a row, with its velocity zeroed. Net force comes
+// from the velocity change, collisions included, so a firefly resting on the
+// table under gravity can sleep. Both lists are kept oldest first (by age),
+// and waking merges back by age, so spawn order survives a round trip.
+class SleepPartition
+{
+public:
+	float speedThreshold = 0.01f;
+	float forceThreshold = 0.01f;
+	int sleepAfterSteps = 30;
+
+	// Counts rest steps over awake, given each one's velocity at the start of
+	// the step, and parks the ones that have rested long enough
+	size_t park(vector<Particle*>& awake, const vec3* startVelocities, float dt);
+	// Parks the awake particles already past sleepAfterSteps, e.g. after a restore
+	size_t parkRested(vector<Particle*>& awake);
+
+	// Moves every sleeper that wake(p) accepts back into awake
+	template <typename Wake>
+	size_t wakeIf(vector<Particle*>& awake, Wake wake)
+	{
+		woken.clear();
+		size_t kept = 0;
+		for (size_t i = 0; i < asleep.size(); i++) {
+			if (wake(asleep[i])) {
+				asleep[i]->restSteps = 0;
+				woken.push_back(asleep[i]);
+			}
+			else {
+				asleep[kept++] = asleep[i];
+			}
+		}
+		asleep.resize(kept);
+		if (!woken.empty()) mergeByAge(awake, woken);
+		return woken.size();
+	}
+
+	// Wakes everything, for changes that affect every particle (toggles)
+	size_t wakeAll(vector<Particle*>& awake);
+	// Wakes sleepers within radius of point (a magnet was placed there)
+	size_t wakeNear(vector<Particle*>& awake, const vec3& point, float radius);
+
+	// Releases the count oldest particles across awake and asleep
+	void releaseOldest(vector<Particle*>& awake, size_t count, ParticlePool& pool);
+	// Releases every sleeper
+	void clear(ParticlePool& pool);
+
+	// awake and asleep merged oldest first, as one list
+	void collect(const vector<Particle*>& awake, vector<Particle*>& out) const;
+
+	vector<Particle*>& getSleeping() { return asleep; }
+	const vector<Particle*>& getSleeping() const { return asleep; }
+
+private:
+	// Merges from (oldest first) into into, keeping into oldest first
+	void mergeByAge(vector<Particle*>& into, const vector<Particle*>& from);
+
+	vector<Particle*> asleep;
+	// Scratch for moves between the lists
+	vector<Particle*> woken;
+	vector<Particle*> parked;
+	vector<Particle*> merged;
+};
+
+#endif // SLEEPPARTITION_H
@@ -0,0 +1,41 @@
+#pragma once
+#ifndef SPRITERENDERER_H
+#define SPRITERENDERER_H
+
+#include <cstddef>
+#include <string>
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Program.h"
+
+using ::glm::mat4;
+using ::glm::vec4;
+
+// Draws light-emitting particles as camera-facing quads: one instance of a
+// four vertex strip per particle, with a soft round falloff in the fragment
+// shader. Writes both scene attachments, so the bloom blur takes the sprites
+// without the brightness threshold. Blending is additive and depth is tested
+// but not written, so sprites need no sorting.
+class SpriteRenderer
+{
+public:
+	bool init(const std::string& resourceDirectory);
+
+	// Streams count vec4(position, 1) to the instance buffer and draws them
+	void draw(const mat4& P, const mat4& V, const vec4* positions, size_t count, float radius);
+	// Draws count particles straight from buffer, read as vec4(position, mass)
+	// every stride bytes, e.g. the GPU simulation's state buffer
+	void drawBuffer(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t count, float radius);
+
+private:
+	void drawInstances(const mat4& P, const mat4& V, GLuint buffer, GLsizei stride, size_t count, float radius);
+
+	Program* program = nullptr;
+	GLuint vaoID = 0;
+	GLuint cornerBufID = 0;
+	GLuint instanceBufID = 0;
+	size_t instanceCapacity = 0;
+};
+
+#endif // SPRITERENDERER_H
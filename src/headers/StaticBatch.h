@@ -0,0 +1,63 @@
+#pragma once
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <vector>
+#include <glad/glad.h>
+
+#include "Shape.h"
+
+using ::std::vector;
+
+// Merges the sub-shapes of a static object into one interleaved vertex buffer
+// and one index buffer. Sub-shapes are grouped by material and each group is
+// drawn with a single glMultiDrawElements over its index ranges.
+class StaticBatch
+{
+public:
+	// Index range of one source sub-shape inside the batch
+	struct Range
+	{
+		const Shape* source;
+		GLsizei count;
+		GLuint firstIndex;
+	};
+
+	// All ranges sharing a material, packed for glMultiDrawElements
+	struct Group
+	{
+		int materialId;
+		vector<Range> ranges;
+		vector<GLsizei> counts;
+		vector<const void*> offsets;
+	};
+
+	// Queue a shape's CPU buffers for merging; call before init()
+	void add(const Shape* shape, int materialId);
+	// Build and upload the merged buffers
+	void init();
+	// Draw every range in one material group
+	void drawGroup(int group) const;
+
+	int getGroupCount() const { return (int) groups.size(); }
+	const Group& getGroup(int group) const { return groups[group]; }
+
+	// Model space bounds of every merged sub-shape (from Shape::measure)
+	vec3 min = vec3(0);
+	vec3 max = vec3(0);
+
+private:
+	struct Pending
+	{
+		const Shape* shape;
+		int materialId;
+	};
+	vector<Pending> pending;
+	vector<Group> groups;
+
+	unsigned int vboID = 0;
+	unsigned int eboID = 0;
+	unsigned int vaoID = 0;
+};
+
+#endif // STATICBATCH_H
@@ -0,0 +1,52 @@
+#pragma once
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// works too, so parallelFor returns once every chunk is done.
+class ThreadPool
+{
+public:
+	// threads = 0 uses one thread per hardware thread
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	// Calls body(begin, end) on chunks of [0, count) of at most grain items.
+	// Chunks run in any order on any thread; body must not write shared state.
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+	// Threads taking part in a parallelFor, including the caller
+	unsigned size() const { return (unsigned) workers.size() + 1; }
+
+	// Pool shared by the simulation passes
+	static ThreadPool& shared();
+
+private:
+	void workerLoop();
+	void runChunks();
+
+	std::vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	bool stopping = false;
+
+	// Current job, valid while busyWorkers > 0 or the caller is in parallelFor
+	const std::function<void(size_t, size_t)>* body = nullptr;
+	size_t count = 0;
+	size_t grain = 1;
+	std::atomic<size_t> nextChunk{ 0 };
+	uint64_t generation = 0;
+	unsigned busyWorkers = 0;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,114 @@
+#pragma once
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glm/gtc/type_ptr.hpp>
+
+using ::glm::vec3;
+using ::std::vector;
+
+// On-disk layout (little endian):
+//   header   "PIOT", u32 version, u32 flags, f32 quantization step, u32 keyframe interval
+//   chunks   one per frame; six columns x, y, z, vx, vy, vz of count values each.
+//            Raw frames store f32 columns. Compressed frames store each column as
+//            u32 byte length + zigzag varints of the quantized value, or of the
+//            difference to the previous frame unless the chunk is a keyframe.
+//   index    per frame: u32 step, u32 count, u64 offset, u32 size, u32 keyframe
+//   footer   u64 index offset, u32 frame count, "PIOI"
+struct TrajectoryFrame
+{
+	uint32_t step;
+	vector<float> columns[6];
+};
+
+// Streams per-step particle snapshots to disk from a background thread
+class TrajectoryWriter
+{
+public:
+	~TrajectoryWriter();
+
+	// quantizationStep > 0 enables delta + quantization compression; values
+	// beyond 2^30 steps are clamped (and counted on close)
+	bool open(const std::string& path, float quantizationStep = 0.0f, uint32_t keyframeInterval = 32);
+	// Copies the snapshot and returns; encoding and disk I/O happen on the writer thread
+	void submit(uint32_t step, const vector<vec3>& positions, const vector<vec3>& velocities);
+	// Flushes queued frames, writes the index and joins the thread
+	void close();
+
+private:
+	struct IndexEntry
+	{
+		uint32_t step;
+		uint32_t count;
+		uint64_t offset;
+		uint32_t size;
+		uint32_t keyframe;
+	};
+
+	void writerLoop();
+	void writeFrame(const TrajectoryFrame& frame);
+
+	std::ofstream file;
+	float quantizationStep = 0.0f;
+	uint32_t keyframeInterval = 32;
+
+	std::thread worker;
+	std::mutex queueLock;
+	std::condition_variable queueReady;
+	std::deque<TrajectoryFrame> queue;
+	bool closing = false;
+
+	// Writer thread only
+	vector<IndexEntry> index;
+	vector<int32_t> previous[6];
+	uint32_t sinceKeyframe = 0;
+	// Values too large for the step, stored at the nearest representable one
+	uint64_t clampedValues = 0;
+};
+
+// Memory maps a trajectory file for random access to any frame. open rejects
+// files whose index or chunks don't fit inside them.
+class TrajectoryReader
+{
+public:
+	~TrajectoryReader();
+
+	bool open(const std::string& path);
+	void close();
+
+	uint32_t getFrameCount() const { return frameCount; }
+	uint32_t getStep(uint32_t frame) const;
+	uint32_t getParticleCount(uint32_t frame) const;
+	// Decodes one frame; compressed frames decode forward from their keyframe
+	bool readFrame(uint32_t frame, vector<vec3>& positions, vector<vec3>& velocities) const;
+
+private:
+	const unsigned char* indexEntry(uint32_t frame) const;
+	// Checks every index entry and chunk lies inside the file
+	bool validateIndex() const;
+	bool decodeColumns(uint32_t frame, vector<int32_t> quantized[6]) const;
+
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+	uint32_t flags = 0;
+	float quantizationStep = 0.0f;
+	uint32_t frameCount = 0;
+	uint64_t indexOffset = 0;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+#endif // TRAJECTORY_H
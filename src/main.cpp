@@ -3,15 +3,43 @@
  */
 
 #include <iostream>
+#include <cmath>
+#include <limits>
 #include <algorithm>
+#include <random>
+#include <sstream>
+#include <type_traits>
 #include <glad/glad.h>
 
 #include "headers/GLSL.h"
+#include "headers/ForceField.h"
+#include "headers/Bvh.h"
+#include "headers/DeferredRenderer.h"
+#include "headers/DistanceField.h"
+#include "headers/DynamicResolution.h"
+#include "headers/Emitter.h"
+#include "headers/Flocking.h"
+#include "headers/Fluid.h"
+#include "headers/Frustum.h"
+#include "headers/Integrator.h"
+#include "headers/GpuParticleSystem.h"
+#include "headers/GpuTimer.h"
+#include "headers/Checkpoint.h"
+#include "headers/InputLog.h"
+#include "headers/Trajectory.h"
 #include "headers/Program.h"
 #include "headers/MatrixStack.h"
+#include "headers/MeshLod.h"
 #include "headers/Shape.h"
 #include "headers/Texture.h"
 #include "headers/Particle.h"
+#include "headers/ParticlePool.h"
+#include "headers/Random.h"
+#include "headers/RenderQueue.h"
+#include "headers/RenderTargetPool.h"
+#include "headers/SleepPartition.h"
+#include "headers/SpriteRenderer.h"
+#include "headers/StaticBatch.h"
 #include "headers/WindowManager.h"
 
 // value_ptr for glm
@@ -20,6 +48,29 @@
 
 #define NUMBER_OF_FIREFLIES 500
 #define FIREFLIES_PER_CLICK 10
+// Half size of the box around the center point that particles may occupy
+#define DOMAIN_HALF_EXTENT 4.0f
+// Reach of a deferred light volume, so lights further than this outside the
+// frustum are skipped there. The forward path keeps every light.
+#define LIGHT_CULL_RADIUS 1.0f
+// Seconds a new window size must hold before the render targets follow it
+#define RESIZE_DEBOUNCE_SECONDS 0.25
+// World space radius of a firefly's glow when drawn as a sprite
+#define FIREFLY_SPRITE_RADIUS 0.02f
+// Gaussian blur passes over the brights, alternating direction
+#define BLUR_PASSES 6
+// Forces on the fireflies, in the order they are summed
+typedef ForcePipeline<PointField, UniformField, RadialFalloffField, FlowGridField, PrecomputedField, PrecomputedField> FireflyForces;
+enum { CenterAttraction, Gravity, MagnetRepulsion, FlyFlight, Flock, FluidPressure };
+// Particle response to hitting the table or globe, and how far off the surface they are put back
+#define COLLISION_RESTITUTION 0.3f
+#define COLLISION_FRICTION 0.1f
+#define COLLISION_SKIN 0.001f
+// Cells per side of the flow field grid over the domain
+#define FLOW_GRID_RESOLUTION 32
+
+// Particle slots for the GPU simulation backend (only the first NUMBER_OF_FIREFLIES light the scene)
+#define GPU_PARTICLE_CAPACITY 65536
 
 class Application : public EventCallbacks
 {
@@ -29,23 +80,102 @@ public:
 	Program* blurBloomShader;
 	Program* sceneShader;
 	Program* finalShader;
+	// Depth only program for the pre-pass (--depth-prepass)
+	Program* depthShader;
+	bool useDepthPrepass = false;
+	// GPU time of the scene draws alone, when set (--bench-prepass)
+	GpuTimer* drawTimer = nullptr;
+	// Surfaces are recorded with the scene shader, or the G-buffer program when deferred
+	Program* surfaceShader = nullptr;
+	// Optional deferred lighting, one light volume per firefly (--deferred)
+	bool useDeferred = false;
+	DeferredRenderer deferred;
+	vector<vec4> lightPositions;
 	// Shapes
 	vector<Shape*> sphere;
 	vec3 sphereOffset;
+	float sphereRadius = 1.0f;
+	// Simplified spheres and a billboard, picked per instance by size on screen
+	vector<Shape*> billboard;
+	vec3 billboardOffset;
+	MeshLod sphereLod;
+	vector<vector<vec3> > lodBuckets;
+	// Fireflies are lights, so by default they are drawn as glowing sprites
+	// rather than lit spheres (--mesh-fireflies for the spheres)
+	bool useSprites = true;
+	SpriteRenderer fireflySprites;
+	vector<vec4> spritePositions;
 	vector<Shape*> table;
 	vec3 tableOffset;
 	float tableScale = 1.5f;
 	vector<Shape*> globe;
 	vec3 globeOffset;
 	float globeScale = 0.0025f;
-	// Existing fireflies
+	// Existing fireflies that are still moving
 	vector<Particle*> fireflies;
+	// Fireflies that came to rest, skipped by the step until something wakes them
+	SleepPartition sleep;
+	// Off with --no-sleep
+	bool allowSleep = true;
 	// Existing magnets
 	vector<Particle*> magnets;
+	// Storage for every particle, reused as they die
+	ParticlePool particlePool;
+	// Steady spawners for the fireflies, on while areEmittersOn
+	vector<Emitter> emitters;
+	// Simulation random numbers, reproducible from the seed
+	Random rng;
+	// Per-step batch of random draws for the center attraction
+	vector<float> attractionDraws;
+	// Wandering flow for the fireflies, rebaked in the background
+	CurlNoiseGrid flowField;
+	// Boids steering between fireflies, recomputed each step while flocking is on
+	Flocking flocking;
+	vector<vec3> flockingForces;
+	// SPH pressure and viscosity between fireflies while fluid mode is on
+	SphFluid fluid;
+	vector<vec3> fluidForces;
+	// Globe triangles the fireflies bounce off
+	TriangleBvh sceneColliders;
+	// The table is a simple prop, so it collides through a baked distance field
+	SignedDistanceField tableField;
+	DistanceFieldCollider tableCollider;
+	vector<vec3> stepStartPositions;
+	vector<vec3> stepStartVelocities;
+	vector<vec3> stepEndPositions;
+	vector<SegmentHit> segmentHits;
+	// Magnet positions for the repulsion field
+	vector<vec3> magnetPositions;
+	FireflyForces fireflyForces;
+	// Integrator for the CPU fireflies (--integrator)
+	IntegratorType integrator = IntegratorType::SymplecticEuler;
+	// Optional GPU simulation of the fireflies (--gpu-sim)
+	bool useGpuSimulation = false;
+	GpuParticleSystem* gpuParticles = nullptr;
 
 	// Textures
 	Texture* globeMapTexture;
 
+	// Sorted draw submission for the scene pass
+	RenderQueue renderQueue;
+	int fireflyMaterial;
+	int magnetMaterial;
+	int globeMaterial;
+	int globeSphereMaterial;
+	int tableMaterial;
+	// Static scene geometry merged per material
+	StaticBatch globeBatch;
+	StaticBatch tableBatch;
+	// Benchmark scenery behind the globe, loaded by initializeScenery
+	vector<Shape*> house;
+	vector<Shape*> trees;
+	StaticBatch houseBatch;
+	StaticBatch treesBatch;
+	mat4 houseTransform;
+	mat4 treesTransform;
+	bool drawHouse = false;
+	bool drawTrees = false;
+
 	// Framebuffer for bloom
 	GLuint bloomFBO;
 	// Texture buffers for bloom
@@ -56,6 +186,24 @@ public:
 	unsigned int pingPongFBO[2];
 	// Texture buffers for pingpong blurring
 	unsigned int pingPongTextures[2];
+	// Where this frame's targets come from, and the size they are made at
+	RenderTargetPool renderTargets;
+	int targetWidth = 0;
+	int targetHeight = 0;
+	// Scene color, and the brights and blur chain that share targets (--scene-format, --bloom-format)
+	GLenum sceneFormat = GL_RGB16F;
+	GLenum bloomFormat = GL_R11F_G11F_B10F;
+	bool resizePending = false;
+	double resizeTime = 0.0;
+	// Size the scene targets were last made at, to report changes
+	int sceneWidth = 0;
+	int sceneHeight = 0;
+	// Optional scene pass scaling to hold a GPU frame time (--dynamic-resolution)
+	bool useDynamicResolution = false;
+	DynamicResolution resolution;
+	GpuTimer sceneTimer;
+	// Targets currently attached to bloomFBO (2 colors, depth) and pingPongFBO
+	GLuint attachedTargets[5] = { 0, 0, 0, 0, 0 };
 	// Blur direction
 	bool horizontal = true;
 
@@ -66,6 +214,27 @@ public:
 	bool isGravityOn = false;
 	bool isMagnetModeOn = false;
 	bool isCenterPointAttractive = false;
+	bool isFlockingOn = false;
+	bool isFluidOn = false;
+	bool areEmittersOn = false;
+
+	// Simulation steps taken so far, and simulated seconds
+	uint32_t simStep = 0;
+	float simTime = 0.0f;
+	// Input waiting for the next step, so it lands on a step boundary
+	vector<InputEvent> pendingEvents;
+	// Optional input log being written (--record) or played back (--replay)
+	InputRecorder* recorder = nullptr;
+	InputReplay* replay = nullptr;
+	// Optional per-step firefly snapshots (--trajectory)
+	TrajectoryWriter* trajectory = nullptr;
+	vector<Particle*> snapshotFireflies;
+	vector<vec3> snapshotPositions;
+	vector<vec3> snapshotVelocities;
+	// Optional checkpoint file, saved every checkpointInterval steps and with F5
+	std::string checkpointPath;
+	uint32_t checkpointInterval = 0;
+	CheckpointWriter checkpointWriter;
 
 	void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 	{
@@ -82,7 +251,7 @@ public:
 			case GLFW_KEY_G:
 				// Toggle gravity only on release (or press, just not both)
 				if (action == GLFW_RELEASE) {
-					isGravityOn = !isGravityOn;
+					queueEvent(InputEvent::ToggleGravity, 0, 0);
 				}
 				break;
 			case GLFW_KEY_M:
@@ -93,14 +262,40 @@ public:
 				break;
 			case GLFW_KEY_TAB:
 				// Clear everything but scene
-				magnets.clear();
-				fireflies.clear();
+				if (action == GLFW_PRESS) {
+					queueEvent(InputEvent::ClearParticles, 0, 0);
+				}
+				break;
+			case GLFW_KEY_F5:
+				// Save a checkpoint now
+				if (action == GLFW_RELEASE && !checkpointPath.empty()) {
+					saveCheckpoint();
+				}
 				break;
 			case GLFW_KEY_C:
 				// Toggle center point attraction
 				if (action == GLFW_RELEASE) {
-					isCenterPointAttractive = !isCenterPointAttractive;
+					queueEvent(InputEvent::ToggleCenterAttraction, 0, 0);
 				}
+				break;
+			case GLFW_KEY_B:
+				// Toggle flocking between fireflies
+				if (action == GLFW_RELEASE) {
+					queueEvent(InputEvent::ToggleFlocking, 0, 0);
+				}
+				break;
+			case GLFW_KEY_E:
+				// Toggle the firefly emitters
+				if (action == GLFW_RELEASE) {
+					queueEvent(InputEvent::ToggleEmitters, 0, 0);
+				}
+				break;
+			case GLFW_KEY_F:
+				// Toggle fluid mode (best with gravity on)
+				if (action == GLFW_RELEASE) {
+					queueEvent(InputEvent::ToggleFluid, 0, 0);
+				}
+				break;
 			default:
 				cerr << "This key is not associated with any program control." << endl;
 		}
@@ -128,19 +323,364 @@ public:
 			float worldSpaceY = -2.0f * posY / height + 1.0f;
 
 			if (!isMagnetModeOn) {
+				queueEvent(InputEvent::SpawnFireflies, worldSpaceX, worldSpaceY);
+			}
+			else {
+				queueEvent(InputEvent::PlaceMagnet, worldSpaceX, worldSpaceY);
+			}
+		}
+	}
+
+	void queueEvent(uint8_t type, float x, float y) {
+		// Replays only take input from the log
+		if (replay) return;
+		InputEvent event = { 0, type, x, y };
+		pendingEvents.push_back(event);
+	}
+
+	// Everything that changes simulation state from input goes through here
+	void applyEvent(const InputEvent& event) {
+		switch (event.type) {
+			case InputEvent::SpawnFireflies:
 				for (int i = 0; i < FIREFLIES_PER_CLICK; i++) {
 					vec3 randVelo = generateRandomVelocityVector();
-					fireflies.push_back(new Particle(generateRandomFloat(0.7f, 1.2f), vec3(worldSpaceX, worldSpaceY, centerPoint.z), randVelo, vec3(0, 0, 0)));
+					float mass = generateRandomFloat(0.7f, 1.2f);
+					if (gpuParticles) {
+						gpuParticles->spawn(mass, vec3(event.x, event.y, centerPoint.z), randVelo);
+						continue;
+					}
+					fireflies.push_back(spawnParticle(mass, vec3(event.x, event.y, centerPoint.z), randVelo));
 				}
+				break;
+			case InputEvent::PlaceMagnet:
+				// The GPU update shader has a fixed magnet array, don't place one it would ignore
+				if (useGpuSimulation && magnets.size() >= MAX_GPU_MAGNETS) {
+					std::cerr << "GPU simulation takes at most " << MAX_GPU_MAGNETS << " magnets, ignoring this one" << std::endl;
+					break;
+				}
+				magnets.push_back(spawnParticle(2.0f, vec3(event.x, event.y, generateRandomFloat(centerPoint.z - 0.5f, centerPoint.z + 0.5f)), vec3(0)));
+				// Magnets push anything within a unit
+				sleep.wakeNear(fireflies, magnets.back()->position, 1.0f);
+				break;
+			case InputEvent::ToggleGravity:
+				isGravityOn = !isGravityOn;
+				sleep.wakeAll(fireflies);
+				break;
+			case InputEvent::ToggleCenterAttraction:
+				isCenterPointAttractive = !isCenterPointAttractive;
+				sleep.wakeAll(fireflies);
+				break;
+			case InputEvent::ToggleFlocking:
+				isFlockingOn = !isFlockingOn;
+				sleep.wakeAll(fireflies);
+				break;
+			case InputEvent::ToggleFluid:
+				isFluidOn = !isFluidOn;
+				sleep.wakeAll(fireflies);
+				break;
+			case InputEvent::ToggleEmitters:
+				areEmittersOn = !areEmittersOn;
+				break;
+			case InputEvent::ClearParticles:
+				for (Particle* p : magnets) retireParticle(p);
+				for (Particle* p : fireflies) retireParticle(p);
+				magnets.clear();
+				fireflies.clear();
+				sleep.clear(particlePool);
+				if (gpuParticles) gpuParticles->clear();
+				break;
+		}
+	}
+
+	static ParticleRecord toRecord(const Particle* p) {
+		ParticleRecord r;
+		r.mass = p->mass;
+		r.position = p->position;
+		r.velocity = p->velocity;
+		r.forces = p->forces;
+		r.age = p->age;
+		r.lifetime = p->lifetime;
+		r.restSteps = (uint32_t) p->restSteps;
+		return r;
+	}
+
+	SimulationSnapshot takeSnapshot() {
+		SimulationSnapshot snapshot;
+		snapshot.simStep = simStep;
+		snapshot.simTime = simTime;
+		snapshot.isGravityOn = isGravityOn;
+		snapshot.isMagnetModeOn = isMagnetModeOn;
+		snapshot.isCenterPointAttractive = isCenterPointAttractive;
+		snapshot.isFlockingOn = isFlockingOn;
+		snapshot.isFluidOn = isFluidOn;
+		snapshot.areEmittersOn = areEmittersOn;
+		for (const Emitter& e : emitters) snapshot.emitterCarry.push_back(e.getCarry());
+		snapshot.rng = rng.getState();
+		// Sleepers too, merged back into spawn order
+		vector<Particle*> everyFirefly;
+		sleep.collect(fireflies, everyFirefly);
+		snapshot.fireflies.reserve(everyFirefly.size());
+		for (Particle* p : everyFirefly) snapshot.fireflies.push_back(toRecord(p));
+		snapshot.magnets.reserve(magnets.size());
+		for (Particle* p : magnets) snapshot.magnets.push_back(toRecord(p));
+		return snapshot;
+	}
+
+	void restoreSnapshot(const SimulationSnapshot& snapshot) {
+		for (Particle* p : magnets) retireParticle(p);
+		for (Particle* p : fireflies) retireParticle(p);
+		magnets.clear();
+		fireflies.clear();
+		sleep.clear(particlePool);
+
+		simStep = snapshot.simStep;
+		simTime = snapshot.simTime;
+		isGravityOn = snapshot.isGravityOn;
+		isMagnetModeOn = snapshot.isMagnetModeOn;
+		isCenterPointAttractive = snapshot.isCenterPointAttractive;
+		isFlockingOn = snapshot.isFlockingOn;
+		isFluidOn = snapshot.isFluidOn;
+		areEmittersOn = snapshot.areEmittersOn;
+		for (size_t i = 0; i < emitters.size() && i < snapshot.emitterCarry.size(); i++) {
+			emitters[i].setCarry(snapshot.emitterCarry[i]);
+		}
+		rng.setState(snapshot.rng);
+		flowField.reset(simStep);
+
+		fireflies.reserve(snapshot.fireflies.size());
+		for (const ParticleRecord& r : snapshot.fireflies) {
+			fireflies.push_back(spawnParticle(r.mass, r.position, r.velocity));
+			fireflies.back()->forces = r.forces;
+			fireflies.back()->age = r.age;
+			fireflies.back()->lifetime = r.lifetime;
+			fireflies.back()->restSteps = (int) r.restSteps;
+		}
+		// Fireflies that were asleep go straight back to sleep
+		if (allowSleep) sleep.parkRested(fireflies);
+		// Down to the population the lights and update() hold, for files saved
+		// elsewhere or by other builds
+		size_t total = fireflies.size() + sleep.getSleeping().size();
+		size_t limit = NUMBER_OF_FIREFLIES - FIREFLIES_PER_CLICK;
+		if (total > limit) {
+			std::cerr << "Checkpoint holds " << total << " fireflies, keeping the newest " << limit << std::endl;
+			sleep.releaseOldest(fireflies, total - limit, particlePool);
+		}
+		for (const ParticleRecord& r : snapshot.magnets) {
+			magnets.push_back(spawnParticle(r.mass, r.position, r.velocity));
+			magnets.back()->forces = r.forces;
+		}
+	}
+
+	void saveCheckpoint() {
+		// Copy on snapshot, the writer thread takes it from here
+		if (!checkpointWriter.save(takeSnapshot(), checkpointPath)) {
+			std::cerr << "Previous checkpoint still being written, skipping" << std::endl;
+		}
+	}
+
+	// Called once a step is complete, so a resumed run starts on the next one
+	// exactly like F5 between steps
+	void saveIntervalCheckpoint() {
+		if (checkpointInterval > 0 && simStep % checkpointInterval == 0) {
+			saveCheckpoint();
+		}
+	}
+
+	// Table placement in the scene, shared by drawing and collision
+	mat4 tableTransform(const vec3& offset) {
+		mat4 model = glm::translate(mat4(1.0f), vec3(0, -0.68, 0));
+		model = glm::scale(model, vec3(tableScale));
+		return glm::translate(model, -offset);
+	}
+
+	mat4 globeTransform(const vec3& offset) {
+		return glm::translate(glm::scale(mat4(1.0f), vec3(globeScale)), -offset);
+	}
+
+	// Loads an OBJ into Shapes for collision only (no GL buffers), with the
+	// same offset initializeShapeFromFile accumulates for drawing
+	static bool loadCollisionShapes(const std::string& path, vector<Shape*>& shapes, vec3& offset) {
+		vector<tinyobj::shape_t> objShapes;
+		vector<tinyobj::material_t> materials;
+		std::string estr;
+		if (!tinyobj::LoadObj(objShapes, materials, estr, path.c_str())) {
+			std::cerr << estr << std::endl;
+			return false;
+		}
+		for (tinyobj::shape_t& s : objShapes) {
+			Shape* shape = new Shape();
+			shape->createShape(s);
+			shape->measure();
+			offset += (shape->min + shape->max) / 2.0f;
+			shapes.push_back(shape);
+		}
+		if (!shapes.empty()) offset /= (float) shapes.size();
+		return true;
+	}
+
+	// Table distance field and globe triangles for particle collision. Loaded
+	// from the OBJs rather than the drawn Shapes so the headless replay (no GL
+	// context) collides the same way.
+	void initializeColliders(const std::string& resource) {
+		vector<Shape*> tableShapes, globeShapes;
+		vec3 tableColliderOffset(0), globeColliderOffset(0);
+		loadCollisionShapes(resource + "/table.obj", tableShapes, tableColliderOffset);
+		loadCollisionShapes(resource + "/globe.obj", globeShapes, globeColliderOffset);
+
+		mat4 scene = glm::translate(mat4(1.0f), centerPoint);
+		vector<const Shape*> tableMesh(tableShapes.begin(), tableShapes.end());
+		if (tableField.loadOrBake(resource + "/table.obj", tableMesh)) {
+			tableCollider.field = &tableField;
+			tableCollider.setTransform(scene * tableTransform(tableColliderOffset), tableScale);
+		}
+		for (Shape* s : globeShapes) sceneColliders.addShape(s, scene * globeTransform(globeColliderOffset));
+		sceneColliders.build();
+
+		// The field and the BVH keep their own copies
+		for (Shape* s : tableShapes) delete s;
+		for (Shape* s : globeShapes) delete s;
+	}
+
+	// Stops fireflies that crossed a globe triangle this step at the surface,
+	// bouncing off with some restitution and friction, then lets the table
+	// field push out and slide anything that ended up against the table
+	void collideWithScene() {
+		tableCollider.collide(fireflies, COLLISION_RESTITUTION, COLLISION_FRICTION, COLLISION_SKIN);
+
+		size_t count = fireflies.size();
+		if (sceneColliders.getTriangleCount() == 0 || count == 0) return;
+
+		stepEndPositions.resize(count);
+		for (size_t i = 0; i < count; i++) stepEndPositions[i] = fireflies[i]->position;
+		segmentHits.resize(count);
+		sceneColliders.intersectSegments(stepStartPositions.data(), stepEndPositions.data(), count, segmentHits.data());
+
+		for (size_t i = 0; i < count; i++) {
+			const SegmentHit& hit = segmentHits[i];
+			if (!hit.hit) continue;
+			Particle* fly = fireflies[i];
+			fly->position = hit.point + hit.normal * COLLISION_SKIN;
+			float along = glm::dot(fly->velocity, hit.normal);
+			if (along < 0.0f) {
+				vec3 tangent = fly->velocity - along * hit.normal;
+				fly->velocity = (1.0f - COLLISION_FRICTION) * tangent - COLLISION_RESTITUTION * along * hit.normal;
 			}
-			else {
-				magnets.push_back(new Particle(2.0f, vec3(worldSpaceX, worldSpaceY, generateRandomFloat(centerPoint.z - 0.5f, centerPoint.z + 0.5f)), vec3(0), vec3(0)));
+		}
+	}
+
+	// A slow drizzle inside a sphere around the center point, and fireflies
+	// lifting off the globe's surface. Loaded like the colliders, without GL.
+	void initializeEmitters(const std::string& resource) {
+		Emitter swarm = Emitter::sphere(centerPoint, 0.5f);
+		swarm.rate = 5.0f;
+		swarm.minLifetime = 8.0f;
+		swarm.maxLifetime = 15.0f;
+		emitters.push_back(swarm);
+
+		vector<Shape*> globeShapes;
+		vec3 offset(0);
+		if (loadCollisionShapes(resource + "/globe.obj", globeShapes, offset)) {
+			vector<const Shape*> surface(globeShapes.begin(), globeShapes.end());
+			Emitter globeSurface = Emitter::meshSurface(surface, glm::translate(mat4(1.0f), centerPoint) * globeTransform(offset));
+			globeSurface.rate = 3.0f;
+			globeSurface.speed = 0.1f;
+			globeSurface.minLifetime = 5.0f;
+			globeSurface.maxLifetime = 10.0f;
+			emitters.push_back(globeSurface);
+		}
+		for (Shape* s : globeShapes) delete s;
+	}
+
+	// Bakes the first flow field from the global seed; needs the seed set first
+	void initializeFlowField() {
+		uint64_t seed = Random::getGlobalSeed();
+		flowField.init(centerPoint, DOMAIN_HALF_EXTENT, FLOW_GRID_RESOLUTION, (uint32_t) (seed ^ (seed >> 32)));
+	}
+
+	// Point the force fields at this step's toggles and random draws
+	void configureForces() {
+		magnetPositions.clear();
+		for (Particle* mag : magnets) magnetPositions.push_back(mag->position);
+
+		// Center attraction grows with distance, scaled by a random draw per fly
+		PointField& attraction = fireflyForces.get<CenterAttraction>();
+		attraction.enabled = isCenterPointAttractive;
+		attraction.center = centerPoint;
+		attraction.distanceScale = 25.0f;
+		attraction.randomScale = attractionDraws.data();
+
+		UniformField& gravity = fireflyForces.get<Gravity>();
+		gravity.enabled = isGravityOn;
+		gravity.force = vec3(0, -0.25f, 0);
+
+		// Magnets push away anything within a unit
+		RadialFalloffField& repulsion = fireflyForces.get<MagnetRepulsion>();
+		repulsion.enabled = !magnetPositions.empty();
+		repulsion.sources = &magnetPositions;
+		repulsion.radius = 1.0f;
+
+		// Fireflies drift along the curl noise flow to simulate fly flight
+		FlowGridField& flight = fireflyForces.get<FlyFlight>();
+		flight.enabled = flowField.isReady();
+		flight.grid = &flowField;
+		flight.speed = 0.4f;
+		flight.response = 0.5f;
+
+		PrecomputedField& flock = fireflyForces.get<Flock>();
+		flock.enabled = isFlockingOn;
+		flock.forces = flockingForces.data();
+
+		PrecomputedField& pressure = fireflyForces.get<FluidPressure>();
+		pressure.enabled = isFluidOn;
+		pressure.forces = fluidForces.data();
+	}
+
+	// FNV-1a over the raw bytes of every particle, for comparing runs
+	uint64_t stateChecksum() {
+		uint64_t h = 0xcbf29ce484222325ULL;
+		auto mix = [&h](const void* data, size_t size) {
+			const unsigned char* bytes = (const unsigned char*) data;
+			for (size_t i = 0; i < size; i++) {
+				h = (h ^ bytes[i]) * 0x100000001b3ULL;
+			}
+		};
+		vector<Particle*> everyFirefly;
+		sleep.collect(fireflies, everyFirefly);
+		for (const vector<Particle*>* group : { &everyFirefly, &magnets }) {
+			for (Particle* p : *group) {
+				mix(&p->mass, sizeof(p->mass));
+				mix(&p->position, sizeof(p->position));
+				mix(&p->velocity, sizeof(p->velocity));
+				mix(&p->forces, sizeof(p->forces));
 			}
 		}
+		return h;
+	}
+
+	Particle* spawnParticle(float mass, vec3 position, vec3 velocity) {
+		return particlePool.acquire(mass, position, velocity);
+	}
+
+	void retireParticle(Particle* p) {
+		particlePool.release(p);
+	}
+
+	bool isExpired(const Particle* p) {
+		return p->lifetime > 0.0f && p->age >= p->lifetime;
+	}
+
+	bool isInsideDomain(const vec3& position) {
+		vec3 offset = glm::abs(position - centerPoint);
+		return offset.x < DOMAIN_HALF_EXTENT && offset.y < DOMAIN_HALF_EXTENT && offset.z < DOMAIN_HALF_EXTENT;
 	}
 
 	vec3 generateRandomVelocityVector() {
-		return vec3(generateRandomFloat(-0.05f, 0.05f), generateRandomFloat(-0.05f, 0.05f), generateRandomFloat(-0.05f, 0.05f));
+		// Separate statements so the draw order doesn't depend on the compiler
+		vec3 v;
+		v.x = generateRandomFloat(-0.05f, 0.05f);
+		v.y = generateRandomFloat(-0.05f, 0.05f);
+		v.z = generateRandomFloat(-0.05f, 0.05f);
+		return v;
 	}
 
 	void cursorPosCallback(GLFWwindow* window, double xpos, double ypos)
@@ -151,6 +691,9 @@ public:
 	void resizeCallback(GLFWwindow* window, int width, int height)
 	{
 		glViewport(0, 0, width, height);
+		// Targets follow once the size settles (see updateTargetSize)
+		resizePending = true;
+		resizeTime = glfwGetTime();
 	}
 
 	//code to set up the two shaders - a diffuse shader and texture mapping
@@ -164,78 +707,234 @@ public:
 		// Enable z-buffer test
 		glEnable(GL_DEPTH_TEST);
 
-		int width, height;
-		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-
 		// Initialize peripherals
 		initializeShaderPrograms(resourceDirectory);
 		initializeGeometry(resourceDirectory);
 		initializeTextures(resourceDirectory);
-		// Create bloomFBO and color attachments
-		initializeBloomFBOs(width, height);
+		initializeMaterials();
+		initializeBatches();
+		if (useGpuSimulation) {
+			gpuParticles = new GpuParticleSystem(GPU_PARTICLE_CAPACITY);
+			if (!gpuParticles->init(resourceDirectory, sphere[0])) {
+				std::cerr << "GPU simulation unavailable, using the CPU path" << std::endl;
+				delete gpuParticles;
+				gpuParticles = nullptr;
+			}
+		}
+		if (useDynamicResolution && !sceneTimer.init()) {
+			useDynamicResolution = false;
+		}
+		if (useDeferred && !deferred.init(resourceDirectory)) {
+			std::cerr << "Deferred renderer unavailable, shading forward" << std::endl;
+			useDeferred = false;
+		}
+		if (useSprites && !fireflySprites.init(resourceDirectory)) {
+			std::cerr << "Sprite renderer unavailable, drawing fireflies as spheres" << std::endl;
+			useSprites = false;
+		}
+		sceneFormat = renderableFormat(sceneFormat, "Scene");
+		bloomFormat = renderableFormat(bloomFormat, "Bloom");
+		// Create bloomFBO, its attachments come from the render target pool
+		initializeBloomFBOs();
 		// Create FBO for ping pong blurring of bloom
-		initializePingPongFBOs(width, height);
+		initializePingPongFBOs();
 	}
 
-	void initializeBloomFBOs(int width, int height) {
-		// Initialize bloom framebuffer (1 buffer, 2 colorbuffers for it)
+	void initializeBloomFBOs() {
+		// Initialize bloom framebuffer (2 colorbuffers and depth, attached per frame from the pool)
 		glGenFramebuffers(1, &bloomFBO);
 		glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
-		// Initialize color buffers for our bloomFBO
-		glGenTextures(2, bloomColorBuffers);
-
-		// Bind texture for configuration
-		for (int i = 0; i < 2; i++) {
-			glBindTexture(GL_TEXTURE_2D, bloomColorBuffers[i]);
-			// Give an empty image to OpenGL (the NULL term)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
-			// Texture and color buffer settings
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			// Attach textures to our bloomFBO
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, bloomColorBuffers[i], 0);
-		}
-		glGenRenderbuffers(1, &rboDepth);
-		glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
-		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
 		// Tell OpenGL to render to multiple colorbuffers through glDrawBuffers
 		unsigned int attachmentsArray[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
 		glDrawBuffers(2, attachmentsArray);
-		// Check framebuffer is complete
-		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-			std::cout << "Framebuffer is not completely setup!" << std::endl;
-		}
-		else {
-			std::cout << "Framebuffer is complete!" << std::endl;
-		}
 		// Reset back to normal
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	}
 
-	void initializePingPongFBOs(int width, int height) {
-		// Ping pong FBO for blurring
+	void initializePingPongFBOs() {
+		// Ping pong FBO for blurring, one color attachment each
 		glGenFramebuffers(2, pingPongFBO);
-		glGenTextures(2, pingPongTextures);
-		// Initialize both texture buffers
-		for (unsigned int i = 0; i < 2; i++) {
+	}
+
+	// Half floats are renderable everywhere, so formats that aren't fall back to them
+	static GLenum renderableFormat(GLenum format, const char* name) {
+		if (RenderTargetPool::isColorRenderable(format)) return format;
+		std::cerr << name << " target format " << colorFormatName(format) << " is not color renderable, using rgb16f" << std::endl;
+		return GL_RGB16F;
+	}
+
+	// A resize is only picked up once the size has held for RESIZE_DEBOUNCE_SECONDS,
+	// so dragging a window edge doesn't reallocate every frame
+	void updateTargetSize(int width, int height) {
+		if (targetWidth == 0 || (resizePending && glfwGetTime() - resizeTime >= RESIZE_DEBOUNCE_SECONDS)) {
+			targetWidth = width;
+			targetHeight = height;
+			resizePending = false;
+		}
+	}
+
+	// This frame's targets from the pool. The brights attachment is dead once
+	// the first blur pass has read it, so it doubles as the blur's second ping
+	// pong target.
+	void acquireRenderTargets(int width, int height) {
+		bloomColorBuffers[0] = renderTargets.acquireTexture(width, height, sceneFormat);
+		bloomColorBuffers[1] = renderTargets.acquireTexture(width, height, bloomFormat);
+		pingPongTextures[0] = bloomColorBuffers[1];
+		pingPongTextures[1] = renderTargets.acquireTexture(width, height, bloomFormat);
+
+		// Deferred draws the scene through its own framebuffers, into the same
+		// scene and brights targets, with normals, albedo and a readable depth
+		if (useDeferred) {
+			GLuint normal = renderTargets.acquireTexture(width, height, GL_RGBA16F);
+			GLuint albedo = renderTargets.acquireTexture(width, height, GL_RGBA16F);
+			deferred.setTargets(bloomColorBuffers[0], bloomColorBuffers[1], normal, albedo, renderTargets.acquireDepthTexture(width, height));
+		}
+		else {
+			rboDepth = renderTargets.acquireDepth(width, height);
+		}
+
+		// Reattach only what changed since last frame
+		if (!useDeferred && (bloomColorBuffers[0] != attachedTargets[0] || bloomColorBuffers[1] != attachedTargets[1] || rboDepth != attachedTargets[2])) {
+			glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+			for (int i = 0; i < 2; i++) {
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, bloomColorBuffers[i], 0);
+			}
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+			checkFramebuffer("Bloom");
+		}
+		for (int i = 0; i < 2; i++) {
+			if (pingPongTextures[i] == attachedTargets[3 + i]) continue;
 			glBindFramebuffer(GL_FRAMEBUFFER, pingPongFBO[i]);
-			glBindTexture(GL_TEXTURE_2D, pingPongTextures[i]);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingPongTextures[i], 0);
-			// Check framebuffer is complete
-			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-				std::cout << "Framebuffer is not completely setup!" << std::endl;
+			checkFramebuffer("Ping pong");
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		if (!useDeferred) {
+			attachedTargets[0] = bloomColorBuffers[0];
+			attachedTargets[1] = bloomColorBuffers[1];
+			attachedTargets[2] = rboDepth;
+		}
+		attachedTargets[3] = pingPongTextures[0];
+		attachedTargets[4] = pingPongTextures[1];
+
+		if (width != sceneWidth || height != sceneHeight) {
+			sceneWidth = width;
+			sceneHeight = height;
+			std::cout << "Render targets " << width << "x" << height << " (" << colorFormatName(sceneFormat) << ", " << colorFormatName(bloomFormat) << "): "
+				<< renderTargets.getBytesInUse() / (1024.0 * 1024.0) << " MB in use, "
+				<< renderTargets.getBytesAllocated() / (1024.0 * 1024.0) << " MB pooled, "
+				<< estimateTargetTraffic(width, height) / (1024.0 * 1024.0) << " MB target traffic per frame" << std::endl;
+		}
+	}
+
+	// Bytes of color targets written and read in a frame, overdraw aside: the
+	// scene writes both colors, each blur pass reads and writes a bloom target,
+	// and the merge reads the scene and the last blur
+	size_t estimateTargetTraffic(int width, int height) const {
+		size_t pixels = (size_t) width * height;
+		return pixels * (2 * RenderTargetPool::bytesPerTexel(sceneFormat) + (2 * BLUR_PASSES + 2) * RenderTargetPool::bytesPerTexel(bloomFormat));
+	}
+
+	// Renders one frame with each pair of target formats and reports the final
+	// image's error against an all float reference, the frame's GPU time and
+	// its target traffic (--compare-formats)
+	void compareTargetFormats(float time, int frames) {
+		const GLenum pairs[][2] = {
+			{ GL_RGBA32F, GL_RGBA32F },
+			{ GL_RGB16F, GL_RGB16F },
+			{ GL_RGB16F, GL_R11F_G11F_B10F },
+			{ GL_R11F_G11F_B10F, GL_R11F_G11F_B10F },
+		};
+		int width, height;
+		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
+		useDynamicResolution = false;
+		GpuTimer timer;
+		timer.init();
+		vector<unsigned char> reference;
+		vector<unsigned char> image((size_t) width * height * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+		for (const auto& pair : pairs) {
+			std::cout << colorFormatName(pair[0]) << " scene, " << colorFormatName(pair[1]) << " bloom: ";
+			if (!RenderTargetPool::isColorRenderable(pair[0]) || !RenderTargetPool::isColorRenderable(pair[1])) {
+				std::cout << "not color renderable, skipped" << std::endl;
+				continue;
 			}
-			else {
-				std::cout << "Framebuffer is complete!" << std::endl;
+			sceneFormat = pair[0];
+			bloomFormat = pair[1];
+			// The first frame allocates the targets, so it isn't timed
+			render(time);
+			double totalMs = 0.0;
+			int timed = 0;
+			for (int i = 0; i < frames; i++) {
+				timer.begin();
+				render(time);
+				timer.end();
+				glFinish();
+				double ms;
+				while (timer.poll(ms)) {
+					totalMs += ms;
+					timed++;
+				}
+			}
+			glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.data());
+			if (reference.empty()) reference = image;
+
+			int maxError = 0;
+			double squaredError = 0.0;
+			for (size_t i = 0; i < image.size(); i++) {
+				int error = std::abs((int) image[i] - (int) reference[i]);
+				maxError = std::max(maxError, error);
+				squaredError += (double) error * error;
+			}
+			double mse = squaredError / image.size();
+			std::cout << (timed ? totalMs / timed : 0.0) << " ms GPU, " << estimateTargetTraffic(width, height) / (1024.0 * 1024.0) << " MB target traffic, max error " << maxError << "/255, ";
+			if (mse > 0.0) std::cout << "PSNR " << 10.0 * std::log10(255.0 * 255.0 / mse) << " dB" << std::endl;
+			else std::cout << "identical" << std::endl;
+		}
+	}
+
+	// GPU time of the scene draws with and without the depth pre-pass, on the
+	// plain scene and with the house and trees added (--bench-prepass)
+	void benchmarkDepthPrepass(const std::string& resource, float time, int frames) {
+		initializeScenery(resource);
+		// Time queries can't nest, so the frame timer stays off
+		useDynamicResolution = false;
+		GpuTimer timer;
+		timer.init();
+		drawTimer = &timer;
+
+		const char* names[4] = { "scene", "scene + house", "scene + trees", "scene + house + trees" };
+		for (int scenery = 0; scenery < 4; scenery++) {
+			drawHouse = (scenery & 1) != 0;
+			drawTrees = (scenery & 2) != 0;
+			std::cout << names[scenery] << ":";
+			for (bool prepass : { false, true }) {
+				useDepthPrepass = prepass;
+				double totalMs = 0.0;
+				int timed = 0;
+				// One untimed frame first, in case anything is still being allocated
+				for (int i = 0; i <= frames; i++) {
+					render(time);
+					glFinish();
+					double ms;
+					while (timer.poll(ms)) {
+						if (i > 0) {
+							totalMs += ms;
+							timed++;
+						}
+					}
+				}
+				std::cout << (prepass ? ", pre-pass " : " forward ") << (timed ? totalMs / timed : 0.0) << " ms";
 			}
+			std::cout << std::endl;
+		}
+		drawTimer = nullptr;
+	}
+
+	void checkFramebuffer(const char* name) {
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << name << " framebuffer is not completely setup!" << std::endl;
 		}
 	}
 
@@ -247,6 +946,34 @@ public:
 		globeMapTexture->init();
 	}
 
+	void initializeMaterials() {
+		// Color, shininess, isLightSource, isGlobeSphere
+		Material firefly = { vec3(0.85, 0.75, 0.60), 15.0f, true, false };
+		Material magnet = { vec3(0.21, 0.21, 0.21), 0.8f, false, false };
+		Material globeBody = { vec3(0.33, 0.40, 0.50), 1.2f, false, false };
+		Material globeSphere = { vec3(0.33, 0.40, 0.50), 1.2f, false, true };
+		Material tableTop = { vec3(0.70, 0.40, 0.25), 0.2f, false, false };
+
+		fireflyMaterial = renderQueue.addMaterial(firefly);
+		magnetMaterial = renderQueue.addMaterial(magnet);
+		globeMaterial = renderQueue.addMaterial(globeBody);
+		globeSphereMaterial = renderQueue.addMaterial(globeSphere);
+		tableMaterial = renderQueue.addMaterial(tableTop);
+	}
+
+	void initializeBatches() {
+		// Sub-shape 9 of the globe is the textured sphere
+		for (size_t shapeNum = 0; shapeNum < globe.size(); shapeNum++) {
+			globeBatch.add(globe[shapeNum], shapeNum == 9 ? globeSphereMaterial : globeMaterial);
+		}
+		globeBatch.init();
+
+		for (Shape* pt : table) {
+			tableBatch.add(pt, tableMaterial);
+		}
+		tableBatch.init();
+	}
+
 	void initializeShaderPrograms(const std::string& resource) {
 		using ::std::cerr;
 		using ::std::endl;
@@ -297,11 +1024,72 @@ public:
 		sceneShader->addUniform("isLightSource");
 		sceneShader->addUniform("isGlobeSphere");
 		sceneShader->addUniform("lights");
+		sceneShader->addUniform("numLights");
+		sceneShader->addUniform("numIdleLights");
 		sceneShader->addUniform("shininess");
 		sceneShader->addUniform("shapeColor");
 		sceneShader->addAttribute("vertPos");
 		sceneShader->addAttribute("vertNor");
 		sceneShader->addAttribute("vertTex");
+		sceneShader->addUniform("useLightBuffer");
+		sceneShader->addUniform("lightBuffer");
+		sceneShader->addUniform("lightBufferStart");
+		sceneShader->addUniform("lightBufferSlots");
+
+		// Buffer texture sampler must not share unit 0 with globeTexture
+		sceneShader->bind();
+		glUniform1i(sceneShader->getUniform("lightBuffer"), 1);
+		sceneShader->unbind();
+
+		// Same vertex shader as the scene, so the depth it writes is the depth the scene tests against
+		depthShader = new Program();
+		// Shape::draw looks up vertNor and vertTex, which the empty fragment
+		// shader lets the linker drop, so missing locations are expected here
+		depthShader->setVerbose(false);
+		depthShader->setShaderNames(resource + "/scene_vert.glsl", resource + "/depth_frag.glsl");
+		if (!depthShader->init()) {
+			cerr << "One or more shaders failed to compile... exiting!" << endl;
+			exit(EXIT_FAILURE);
+		}
+		depthShader->addUniform("P");
+		depthShader->addUniform("V");
+		depthShader->addUniform("M");
+		depthShader->addAttribute("vertPos");
+		depthShader->addAttribute("vertNor");
+		depthShader->addAttribute("vertTex");
+	}
+
+	// Scales a loaded model to height and stands its base at position
+	static mat4 standOn(const vector<Shape*>& shapes, const vec3& position, float height) {
+		vec3 low(std::numeric_limits<float>::max());
+		vec3 high(-std::numeric_limits<float>::max());
+		for (const Shape* shape : shapes) {
+			low = glm::min(low, shape->min);
+			high = glm::max(high, shape->max);
+		}
+		vec3 base((low.x + high.x) / 2.0f, low.y, (low.z + high.z) / 2.0f);
+		float scale = height / std::max(high.y - low.y, 1e-6f);
+		return glm::scale(glm::translate(mat4(1.0f), position), vec3(scale)) * glm::translate(mat4(1.0f), -base);
+	}
+
+	// House and trees standing on the table line behind the globe, where
+	// the globe and table hide much of them
+	void initializeScenery(const std::string& resource) {
+		Material walls = { vec3(0.55, 0.45, 0.35), 2.0f, false, false };
+		Material foliage = { vec3(0.25, 0.45, 0.20), 1.0f, false, false };
+		int wallsMaterial = renderQueue.addMaterial(walls);
+		int foliageMaterial = renderQueue.addMaterial(foliage);
+
+		vec3 houseOffset(0), treesOffset(0);
+		initializeShapeFromFile(&house, resource + "/house.obj", &houseOffset);
+		initializeShapeFromFile(&trees, resource + "/trees.obj", &treesOffset);
+		for (Shape* shape : house) houseBatch.add(shape, wallsMaterial);
+		for (Shape* shape : trees) treesBatch.add(shape, foliageMaterial);
+		houseBatch.init();
+		treesBatch.init();
+		// Relative to centerPoint, like the globe and table
+		houseTransform = standOn(house, vec3(-0.5, -0.68, -1.2), 0.6f);
+		treesTransform = standOn(trees, vec3(0.6, -0.68, -1.4), 1.0f);
 	}
 
 	void initializeGeometry(const std::string& resource)
@@ -309,6 +1097,68 @@ public:
 		initializeShapeFromFile(&globe, resource + "/globe.obj", &globeOffset);
 		initializeShapeFromFile(&sphere, resource + "/sphere.obj", &sphereOffset);
 		initializeShapeFromFile(&table, resource + "/table.obj", &tableOffset);
+
+		// Bounding radius of the unscaled sphere mesh, for culling
+		if (!sphere.empty()) {
+			sphereRadius = glm::length(sphere[0]->max - sphere[0]->min) / 2.0f;
+			initializeSphereLod(resource);
+		}
+	}
+
+	// Full sphere down to 24 pixels across, half the triangles to 12, a quarter
+	// to 4, and the billboard below that
+	void initializeSphereLod(const std::string& resource) {
+		sphereLod.build(sphere[0], { 0.5f, 0.25f }, { 24.0f, 12.0f, 4.0f });
+		initializeShapeFromFile(&billboard, resource + "/billboard.obj", &billboardOffset);
+		if (!billboard.empty()) sphereLod.setBillboard(billboard[0]);
+
+		std::cout << "Sphere LOD triangles:";
+		for (int level = 0; level <= sphereLod.getLevelCount(); level++) {
+			std::cout << " " << sphereLod.getTriangleCount(level);
+		}
+		std::cout << std::endl;
+		lodBuckets.resize(sphereLod.getLevelCount() + 1);
+	}
+
+	// Records a sphere of the given scale at each particle in view, at the level
+	// of detail its size on screen calls for. Instances are grouped by level so
+	// each level's draws go out back to back.
+	void recordSpheres(const vector<const vector<Particle*>*>& groups, float scale, int material,
+		const Frustum& frustum, const mat4& P, const mat4& V, int height, MatrixStack* M) {
+		if (sphere.empty()) return;
+		for (vector<vec3>& bucket : lodBuckets) bucket.clear();
+		// Mesh radius, not the bounding box diagonal, so pixels match what is drawn
+		float radius = (sphere[0]->max.x - sphere[0]->min.x) / 2.0f * scale;
+		for (const vector<Particle*>* group : groups) {
+			for (Particle* p : *group) {
+				if (!frustum.containsSphere(p->position, sphereRadius * scale)) continue;
+				vec3 viewPosition = vec3(V * vec4(p->position, 1.0f));
+				int level = sphereLod.select(MeshLod::projectedPixels(P, viewPosition, radius, height));
+				lodBuckets[level].push_back(p->position);
+			}
+		}
+
+		// Billboards turn with the inverse of the view rotation to face the camera
+		mat4 facing = glm::transpose(V);
+		facing[0][3] = facing[1][3] = facing[2][3] = 0.0f;
+		facing[3] = vec4(0, 0, 0, 1);
+
+		for (int level = 0; level < (int) lodBuckets.size(); level++) {
+			const Shape* shape = sphereLod.getShape(level);
+			for (const vec3& position : lodBuckets[level]) {
+				M->pushMatrix();
+				M->translate(position);
+				if (sphereLod.isBillboard(level)) {
+					M->multMatrix(facing);
+					M->scale(radius);
+				}
+				else {
+					M->scale(scale);
+				}
+				renderQueue.submit(surfaceShader, nullptr, material, shape, M->topMatrix());
+				M->popMatrix();
+			}
+		}
 	}
 
 	void initializeShapeFromFile(vector<Shape*>* inShape, const std::string& resource, vec3* offset) {
@@ -347,60 +1197,164 @@ public:
 	}
 
 	float generateRandomFloat(float lowBound, float highBound) {
-		return rand() % 100 / 100.0f * (highBound - lowBound) + lowBound;
+		return rng.nextFloat(lowBound, highBound);
 	}
 
 	void update(float dtime) {
-		for (Particle* fly : fireflies) {
-			// Update individual particle
-			fly->update(dtime);
-			// Apply center is attractive if toggled
-			if (isCenterPointAttractive) {
-				// Get distance from center
-				vec3 forceVectorTowardsCenter = centerPoint - fly->position;
-				float distFromCenter = glm::length(forceVectorTowardsCenter) / 25.0f;
-
-				fly->addForce(distFromCenter * generateRandomFloat(0.1f, 0.25f) * forceVectorTowardsCenter);
-			}
-			// Apply gravity if toggled
-			if (isGravityOn) fly->addForce(vec3(0, -0.25f, 0));
-			// Check repel magnets against fireflies
-			for (Particle* mag : magnets) {
-				// Apply repellant force away
-				vec3 forceVector = fly->position - mag->position;
-				if (glm::length(forceVector) < 1.0f) fly->addForce(forceVector);
+		// Apply input at the step boundary, from the log when replaying
+		InputEvent event;
+		if (replay) {
+			while (replay->next(simStep, event)) applyEvent(event);
+		}
+		else {
+			for (InputEvent& e : pendingEvents) {
+				e.step = simStep;
+				if (recorder) recorder->record(e);
+				applyEvent(e);
 			}
-			// Apply small random force in any direction to simulate fly flight
-			fly->addForce(generateRandomVelocityVector());
+			pendingEvents.clear();
+		}
+		simStep++;
+		simTime += dtime;
+
+		if (gpuParticles) {
+			GpuSimParams params;
+			params.dt = dtime;
+			params.isGravityOn = isGravityOn;
+			params.isCenterPointAttractive = isCenterPointAttractive;
+			params.centerPoint = centerPoint;
+			params.domainHalfExtent = DOMAIN_HALF_EXTENT;
+			for (Particle* mag : magnets) params.magnets.push_back(mag->position);
+			gpuParticles->step(params);
+			saveIntervalCheckpoint();
+			return;
 		}
 
+		flowField.advance(simStep);
+		// A new flow generation may now push on sleepers that rested in a calm spot
+		if (flowField.isReady() && simStep % flowField.refreshInterval == 0) {
+			const FlowGridField& flight = fireflyForces.get<FlyFlight>();
+			float threshold2 = sleep.forceThreshold * sleep.forceThreshold;
+			sleep.wakeIf(fireflies, [&flight, threshold2](const Particle* p) {
+				vec3 force(0);
+				flight.accumulate(*p, 0, force);
+				return glm::dot(force, force) >= threshold2;
+			});
+		}
+
+		if (areEmittersOn) {
+			for (Emitter& e : emitters) e.emit(dtime, rng, particlePool, fireflies);
+		}
+
+		// Draw this step's random numbers in a batch
+		size_t count = fireflies.size();
+		if (isCenterPointAttractive) {
+			attractionDraws.resize(count);
+			rng.fill(attractionDraws.data(), attractionDraws.size(), 0.1f, 0.25f);
+		}
+		if (isFlockingOn) {
+			flocking.compute(fireflies, flockingForces);
+		}
+		if (isFluidOn) {
+			fluid.compute(fireflies, fluidForces);
+		}
+
+		configureForces();
+
+		// Evaluate the forces at this step's state and integrate in one pass
+		stepStartPositions.resize(count);
+		stepStartVelocities.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			stepStartPositions[i] = fireflies[i]->position;
+			stepStartVelocities[i] = fireflies[i]->velocity;
+		}
+		integrateParticles(integrator, fireflies, dtime, fireflyForces);
+		collideWithScene();
+
+		// Park whatever has settled. Flocking and fluid couple every firefly to
+		// its neighbours, so nothing sleeps while they are on.
+		if (allowSleep && !isFlockingOn && !isFluidOn) {
+			sleep.park(fireflies, stepStartVelocities.data(), dtime);
+		}
+
+		// Age everyone, then retire fireflies that left the domain or outlived
+		// their lifetime in one compaction, keeping the rest in spawn order.
+		// Sleepers don't move, so only their lifetime can run out.
+		for (Particle* fly : fireflies) fly->age += dtime;
+		for (Particle* fly : sleep.getSleeping()) fly->age += dtime;
+		particlePool.releaseIf(fireflies, [this](const Particle* p) {
+			return !isInsideDomain(p->position) || isExpired(p);
+		});
+		particlePool.releaseIf(sleep.getSleeping(), [this](const Particle* p) {
+			return isExpired(p);
+		});
+
 		// Check to make sure we don't surpass 500 (arbitrary limit, defined for shader because shaders don't like variable arrays?)
-		if (fireflies.size() > NUMBER_OF_FIREFLIES - FIREFLIES_PER_CLICK) {
-			for (int i = 0; i < FIREFLIES_PER_CLICK; i++) {
-				fireflies.erase(fireflies.begin() + i);
+		size_t total = fireflies.size() + sleep.getSleeping().size();
+		size_t limit = NUMBER_OF_FIREFLIES - FIREFLIES_PER_CLICK;
+		if (total > limit) {
+			// Oldest first; emitters can overshoot by more than a click's worth
+			sleep.releaseOldest(fireflies, std::max(total - limit, (size_t) FIREFLIES_PER_CLICK), particlePool);
+		}
+
+		if (trajectory) {
+			snapshotPositions.clear();
+			snapshotVelocities.clear();
+			sleep.collect(fireflies, snapshotFireflies);
+			for (Particle* fly : snapshotFireflies) {
+				snapshotPositions.push_back(fly->position);
+				snapshotVelocities.push_back(fly->velocity);
 			}
+			trajectory->submit(simStep, snapshotPositions, snapshotVelocities);
 		}
+		saveIntervalCheckpoint();
 	}
 
 	void render(float time) {
 		// Get current frame buffer size
 		int width, height;
 		glfwGetFramebufferSize(windowManager->getHandle(), &width, &height);
-		// Set window size
-		glViewport(0, 0, width, height);
-		// Bind and clear bloom framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		// Scene and blur render at the settled target size, scaled down when
+		// dynamic resolution needs to, and the merge stretches it to the window
+		updateTargetSize(width, height);
+		float scale = useDynamicResolution ? resolution.getScale() : 1.0f;
+		int renderWidth = std::max(1, (int) (targetWidth * scale + 0.5f));
+		int renderHeight = std::max(1, (int) (targetHeight * scale + 0.5f));
+		acquireRenderTargets(renderWidth, renderHeight);
+		glViewport(0, 0, renderWidth, renderHeight);
+		if (useDynamicResolution) sceneTimer.begin(scale);
+		// Bind and clear bloom framebuffer, or the G-buffer when deferred
+		if (useDeferred) {
+			deferred.beginGeometry();
+		}
+		else {
+			glBindFramebuffer(GL_FRAMEBUFFER, bloomFBO);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		}
 
 
 		// Draw objects to our bound FBO (bloomFBO)
 		// *** the scene shader has outputs to 2 color attachments ***
-		drawObjects(width, height, time);
+		if (drawTimer) drawTimer->begin();
+		drawObjects(renderWidth, renderHeight, time);
+		if (drawTimer) drawTimer->end();
 
 		// Gaussian blur brightness passes
-		gaussianBlurPingPongCode(width, height);
+		gaussianBlurPingPongCode(renderWidth, renderHeight);
+		if (useDynamicResolution) {
+			sceneTimer.end();
+			// Results arrive a few frames late; take whatever has finished
+			double gpuMs;
+			float issuedScale;
+			while (sceneTimer.poll(gpuMs, issuedScale)) {
+				if (resolution.addSample(gpuMs, issuedScale)) {
+					std::cout << "Scene GPU time " << resolution.getAverageMs() << " ms, render scale now " << resolution.getScale() << std::endl;
+				}
+			}
+		}
 		// Bind and clear screen framebuffer
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width, height);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// Bind final shader
 		finalShader->bind();
@@ -413,17 +1367,26 @@ public:
 		// Render to billboard
 		renderQuad();
 		finalShader->unbind();
+
+		// Hand the targets back; same size next frame gets the same textures
+		renderTargets.releaseAll();
+		renderTargets.endFrame();
 	}
 
 	void gaussianBlurPingPongCode(int width, int height) {
+		// Passes pair up horizontal then vertical, so the blur is separable and
+		// ends with the result in pingPongTextures[0], where render reads it
+		static_assert(BLUR_PASSES % 2 == 0, "BLUR_PASSES must be even");
 		// Blurring iteration
 		bool firstPass = true;
-		int amount = 6;
+		// The first pass reads the brights, which alias pingPongTextures[0], so
+		// it has to write pingPongTextures[1]
+		horizontal = true;
 
 		// Use shader on GPU for speed?
 		blurBloomShader->bind();
 		// Loop to blur
-		for (unsigned int i = 0; i < amount; i++) {
+		for (unsigned int i = 0; i < BLUR_PASSES; i++) {
 			glBindFramebuffer(GL_FRAMEBUFFER, pingPongFBO[horizontal]);
 			// Send horizontal uniform to GLSL
 			glUniform1i(blurBloomShader->getUniform("horizontal"), horizontal);
@@ -489,101 +1452,155 @@ public:
 		M->pushMatrix();
 		M->loadIdentity();
 
-		// Generate light positions array
+		Frustum frustum;
+		frustum.extract(P->topMatrix() * V->topMatrix());
+
+		// Generate light positions array from every firefly, awake or asleep; the
+		// forward shader has no light cutoff, so any of them can reach what we see
 		vec3 lightsArray[NUMBER_OF_FIREFLIES];
-		for (int f = 0; f < fireflies.size(); f++) {
-			lightsArray[f] = fireflies[f]->position;
+		int numLights = 0;
+		for (const vector<Particle*>* group : { &fireflies, &sleep.getSleeping() }) {
+			for (Particle* fly : *group) {
+				if (numLights == NUMBER_OF_FIREFLIES) break;
+				lightsArray[numLights++] = fly->position;
+			}
 		}
 
-		// Bind scene shader
-		sceneShader->bind();
+		// Bind scene shader, or the G-buffer program which leaves the lights for later
+		surfaceShader = useDeferred ? deferred.getGeometryProgram() : sceneShader;
+		surfaceShader->bind();
 
 		// Send common uniforms over
-		glUniformMatrix4fv(sceneShader->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
-		glUniformMatrix4fv(sceneShader->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
-		glUniform3fv(sceneShader->getUniform("lights"), NUMBER_OF_FIREFLIES, value_ptr(lightsArray[0]));
-		glUniform1i(sceneShader->getUniform("isGlobeSphere"), false);
-		// Bind texture
-		glUniform1i(sceneShader->getUniform("globeTexture"), 0);
-		globeMapTexture->bind(sceneShader->getUniform("globeTexture"));
-
-		// Draw fireflies
-		for (Particle* fly : fireflies) {
-			M->pushMatrix();
-			M->translate(fly->position);
-			M->scale(0.01f);
-
-			glUniformMatrix4fv(sceneShader->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-			glUniform1i(sceneShader->getUniform("isLightSource"), true);
-			glUniform3f(sceneShader->getUniform("shapeColor"), 0.85, 0.75, 0.60);
-			glUniform1f(sceneShader->getUniform("shininess"), 15.0f);
-
-			for (Shape* part : sphere) {
-				part->draw(sceneShader);
+		glUniformMatrix4fv(surfaceShader->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
+		glUniformMatrix4fv(surfaceShader->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
+		if (gpuParticles) {
+			// Lights come straight from the simulation buffer, no culling: the newest
+			// slots, so fresh spawns light the scene once the oldest have died. The
+			// forward shader counts dead slots among them as idle; deferred can't see
+			// them before the light pass and leaves them dark.
+			numLights = std::min(gpuParticles->getCount(), NUMBER_OF_FIREFLIES);
+			glUniform1i(surfaceShader->getUniform("numIdleLights"), NUMBER_OF_FIREFLIES - numLights);
+			if (!useDeferred) {
+				gpuParticles->bindStateTexture(GL_TEXTURE1);
+				glUniform1i(sceneShader->getUniform("useLightBuffer"), true);
+				glUniform1i(sceneShader->getUniform("lightBufferStart"), gpuParticles->getNewestSlot(numLights));
+				glUniform1i(sceneShader->getUniform("lightBufferSlots"), gpuParticles->getCapacity());
+				glUniform1i(sceneShader->getUniform("numLights"), numLights);
 			}
-			M->popMatrix();
 		}
-		// Draw magnets
-		for (Particle* ma : magnets) {
-			M->pushMatrix();
-			M->translate(ma->position);
-			M->scale(0.1f);
-
-			glUniformMatrix4fv(sceneShader->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-			glUniform1i(sceneShader->getUniform("isLightSource"), false);
-			glUniform3f(sceneShader->getUniform("shapeColor"), 0.21, 0.21, 0.21);
-			glUniform1f(sceneShader->getUniform("shininess"), 0.8f);
-
-			for (Shape* s : sphere) {
-				s->draw(sceneShader);
+		else {
+			// Empty slots have always sat at the origin, keep their contribution
+			glUniform1i(surfaceShader->getUniform("numIdleLights"), NUMBER_OF_FIREFLIES - numLights);
+			if (!useDeferred) {
+				glUniform3fv(sceneShader->getUniform("lights"), numLights, value_ptr(lightsArray[0]));
+				glUniform1i(sceneShader->getUniform("useLightBuffer"), false);
+				glUniform1i(sceneShader->getUniform("numLights"), numLights);
 			}
-			M->popMatrix();
 		}
 
+		// Record fireflies, awake or asleep, unless they go out as sprites, and magnets
+		if (!useSprites) {
+			recordSpheres({ &fireflies, &sleep.getSleeping() }, 0.01f, fireflyMaterial, frustum, P->topMatrix(), V->topMatrix(), height, M.get());
+		}
+		recordSpheres({ &magnets }, 0.1f, magnetMaterial, frustum, P->topMatrix(), V->topMatrix(), height, M.get());
+
 		// Translate scene back (instead of moving camera position, which we could do instead)
 		M->translate(centerPoint);
 
-		// Draw globe
-		for (int shapeNum = 0; shapeNum < globe.size(); shapeNum++) {
-			M->pushMatrix();
-			M->scale(globeScale);
-			M->translate(-globeOffset);
-
-			if (shapeNum == 9) {
-				glUniform1i(sceneShader->getUniform("isGlobeSphere"), true);
-			}
+		// Record globe, one draw per material group
+		M->pushMatrix();
+		M->multMatrix(globeTransform(globeOffset));
+		if (frustum.containsBox(globeBatch.min, globeBatch.max, M->topMatrix())) {
+			renderQueue.submit(surfaceShader, globeMapTexture, &globeBatch, M->topMatrix());
+		}
+		M->popMatrix();
 
-			glUniformMatrix4fv(sceneShader->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-			glUniform1i(sceneShader->getUniform("isLightSource"), false);
-			glUniform3f(sceneShader->getUniform("shapeColor"), 0.33, 0.40, 0.50);
-			glUniform1f(sceneShader->getUniform("shininess"), 1.2f);
+		// Record table
+		M->pushMatrix();
+		M->multMatrix(tableTransform(tableOffset));
+		if (frustum.containsBox(tableBatch.min, tableBatch.max, M->topMatrix())) {
+			renderQueue.submit(surfaceShader, nullptr, &tableBatch, M->topMatrix());
+		}
+		M->popMatrix();
 
-			globe[shapeNum]->draw(sceneShader);
-			M->popMatrix();
+		// Record benchmark scenery
+		if (drawHouse) {
+			mat4 model = M->topMatrix() * houseTransform;
+			if (frustum.containsBox(houseBatch.min, houseBatch.max, model)) renderQueue.submit(surfaceShader, nullptr, &houseBatch, model);
+		}
+		if (drawTrees) {
+			mat4 model = M->topMatrix() * treesTransform;
+			if (frustum.containsBox(treesBatch.min, treesBatch.max, model)) renderQueue.submit(surfaceShader, nullptr, &treesBatch, model);
 		}
 
-		// Reset globe sphere texture
-		glUniform1i(sceneShader->getUniform("isGlobeSphere"), false);
+		// Depth pre-pass: lay down depth with the trivial program, then shade
+		// only the fragments that match it, so each pixel is lit once
+		if (useDepthPrepass) {
+			depthShader->bind();
+			glUniformMatrix4fv(depthShader->getUniform("P"), 1, GL_FALSE, value_ptr(P->topMatrix()));
+			glUniformMatrix4fv(depthShader->getUniform("V"), 1, GL_FALSE, value_ptr(V->topMatrix()));
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			renderQueue.drawDepth(depthShader);
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			depthShader->unbind();
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
 
-		// Draw table
-		for (Shape* pt : table) {
-			M->pushMatrix();
-			M->translate(vec3(0, -0.68, 0));
-			M->scale(tableScale);
-			M->translate(-tableOffset);
-			
-			glUniformMatrix4fv(sceneShader->getUniform("M"), 1, GL_FALSE, value_ptr(M->topMatrix()));
-			glUniform1i(sceneShader->getUniform("isLightSource"), false);
-			glUniform3f(sceneShader->getUniform("shapeColor"), 0.70, 0.40, 0.25);
-			glUniform1f(sceneShader->getUniform("shininess"), 0.2f);
-
-			pt->draw(sceneShader);
-			M->popMatrix();
+		// Sort and draw everything recorded above
+		renderQueue.flush();
+		if (useDepthPrepass) {
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
 		}
+
 		// Unbind texture
 		globeMapTexture->unbind();
 		// Unbind
-		sceneShader->unbind();
+		surfaceShader->unbind();
+
+		// Deferred lighting: each light shades the pixels inside its volume,
+		// then the brights are picked out for the bloom
+		if (useDeferred) {
+			if (gpuParticles) {
+				// The newest slots, as the forward shader reads them, in two runs if they wrap
+				int first = gpuParticles->getNewestSlot(numLights);
+				int run = std::min(numLights, gpuParticles->getCapacity() - first);
+				deferred.drawLightBuffer(P->topMatrix(), V->topMatrix(), gpuParticles->getStateBuffer(), sizeof(GpuParticle), first, run, LIGHT_CULL_RADIUS, width, height);
+				deferred.drawLightBuffer(P->topMatrix(), V->topMatrix(), gpuParticles->getStateBuffer(), sizeof(GpuParticle), 0, numLights - run, LIGHT_CULL_RADIUS, width, height);
+			}
+			else {
+				lightPositions.clear();
+				// Volumes that miss the frustum can't shade anything visible
+				for (int i = 0; i < numLights; i++) {
+					if (frustum.containsSphere(lightsArray[i], LIGHT_CULL_RADIUS)) lightPositions.push_back(vec4(lightsArray[i], 1.0f));
+				}
+				deferred.drawLights(P->topMatrix(), V->topMatrix(), lightPositions.data(), lightPositions.size(), LIGHT_CULL_RADIUS, width, height);
+			}
+			deferred.resolve();
+		}
+
+		// Sprites go last, over the opaque scene
+		if (useSprites) {
+			spritePositions.clear();
+			for (const vector<Particle*>* group : { &fireflies, &sleep.getSleeping() }) {
+				for (Particle* fly : *group) {
+					if (frustum.containsSphere(fly->position, FIREFLY_SPRITE_RADIUS)) {
+						spritePositions.push_back(vec4(fly->position, 1.0f));
+					}
+				}
+			}
+			fireflySprites.draw(P->topMatrix(), V->topMatrix(), spritePositions.data(), spritePositions.size(), FIREFLY_SPRITE_RADIUS);
+		}
+
+		// GPU simulated fireflies, one instanced draw
+		if (gpuParticles && useSprites) {
+			// Straight from the simulation buffer, no copy
+			fireflySprites.drawBuffer(P->topMatrix(), V->topMatrix(), gpuParticles->getStateBuffer(), sizeof(GpuParticle), gpuParticles->getCount(), FIREFLY_SPRITE_RADIUS);
+		}
+		else if (gpuParticles) {
+			gpuParticles->draw(P->topMatrix(), V->topMatrix(), 0.01f);
+		}
 
 		// Pop matrix stacks.
 		M->popMatrix();
@@ -592,16 +1609,245 @@ public:
 	}
 };
 
+// Numeric flag values, where a malformed or out of range one is a usage error.
+// positive also rejects zero and below, for sizes, counts and time steps.
+template <typename T>
+static T parseFlagValue(const std::string& flag, const std::string& value, bool positive = false)
+{
+	std::istringstream in(value);
+	T result;
+	// Streams wrap a leading minus into unsigned types instead of failing
+	bool negative = std::is_unsigned<T>::value && value.find('-') != std::string::npos;
+	if (!negative && in >> result && in.peek() == std::char_traits<char>::eof()) {
+		if (!positive || result > 0) return result;
+		std::cerr << flag << " must be positive, got " << value << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::cerr << "Invalid value " << value << " for " << flag << std::endl;
+	exit(EXIT_FAILURE);
+}
+
 int main(int argc, char** argv)
 {
 	float time = 0.0;
 	float dtime = 0.1f;
 
-	// Where the resources are loaded from
-	std::string resources = (argc >= 2) ? argv[1] : "../resources";
+	// Where the resources are loaded from, plus option flags
+	std::string resources = "../resources";
+	bool useGpuSimulation = false;
+	uint64_t seed = std::random_device()();
+	std::string recordPath;
+	std::string replayPath;
+	std::string trajectoryPath;
+	float trajectoryQuantization = 0.0f;
+	std::string checkpointPath;
+	uint32_t checkpointInterval = 0;
+	IntegratorType integrator = IntegratorType::SymplecticEuler;
+	bool allowSleep = true;
+	bool useSprites = true;
+	bool useDeferred = false;
+	bool useDepthPrepass = false;
+	int benchPrepassFrames = 0;
+	bool useDynamicResolution = false;
+	DynamicResolution resolution;
+	GLenum sceneFormat = GL_RGB16F;
+	GLenum bloomFormat = GL_R11F_G11F_B10F;
+	bool compareFormats = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--gpu-sim") {
+			useGpuSimulation = true;
+		}
+		else if (arg == "--seed" && i + 1 < argc) {
+			seed = parseFlagValue<uint64_t>(arg, argv[++i]);
+		}
+		else if (arg == "--record" && i + 1 < argc) {
+			recordPath = argv[++i];
+		}
+		else if (arg == "--replay" && i + 1 < argc) {
+			replayPath = argv[++i];
+		}
+		else if (arg == "--trajectory" && i + 1 < argc) {
+			trajectoryPath = argv[++i];
+		}
+		else if (arg == "--trajectory-quantize" && i + 1 < argc) {
+			trajectoryQuantization = parseFlagValue<float>(arg, argv[++i]);
+			if (!(trajectoryQuantization >= 0.0f)) {
+				std::cerr << arg << " must be 0 (lossless) or a positive step" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--checkpoint" && i + 1 < argc) {
+			checkpointPath = argv[++i];
+		}
+		else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+			checkpointInterval = parseFlagValue<uint32_t>(arg, argv[++i]);
+		}
+		else if (arg == "--integrator" && i + 1 < argc) {
+			if (!parseIntegratorType(argv[++i], integrator)) {
+				std::cerr << "Unknown integrator " << argv[i] << ", expected symplectic-euler, velocity-verlet, rk4 or adaptive" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--dt" && i + 1 < argc) {
+			dtime = parseFlagValue<float>(arg, argv[++i], true);
+		}
+		else if (arg == "--bench-flocking") {
+			size_t boids = (i + 1 < argc && argv[i + 1][0] != '-') ? parseFlagValue<size_t>(arg, argv[++i], true) : 100000;
+			benchmarkFlocking(boids, 60);
+			exit(EXIT_SUCCESS);
+		}
+		else if (arg == "--bake-sdf" && i + 1 < argc) {
+			// Offline bake of any OBJ into its .sdf cache
+			std::string path = argv[++i];
+			int resolution = (i + 1 < argc && argv[i + 1][0] != '-') ? parseFlagValue<int>(arg + " resolution", argv[++i], true) : 64;
+			vector<Shape*> shapes;
+			vec3 offset(0);
+			if (!Application::loadCollisionShapes(path, shapes, offset)) exit(EXIT_FAILURE);
+			SignedDistanceField field;
+			if (!field.loadOrBake(path, vector<const Shape*>(shapes.begin(), shapes.end()), resolution)) exit(EXIT_FAILURE);
+			std::cout << path << ".sdf: " << field.getStoredBrickCount() << " of " << field.getBrickCount() << " bricks stored" << std::endl;
+			exit(EXIT_SUCCESS);
+		}
+		else if (arg == "--dynamic-resolution") {
+			// Optional GPU budget in milliseconds for the scene and blur passes
+			useDynamicResolution = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-') resolution.targetMs = parseFlagValue<double>(arg, argv[++i], true);
+		}
+		else if (arg == "--resolution-scale" && i + 2 < argc) {
+			resolution.minScale = parseFlagValue<float>(arg, argv[++i], true);
+			resolution.maxScale = parseFlagValue<float>(arg, argv[++i], true);
+			if (resolution.minScale > resolution.maxScale) {
+				std::cerr << arg << " takes the minimum scale first, got " << resolution.minScale << " > " << resolution.maxScale << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if ((arg == "--scene-format" || arg == "--bloom-format") && i + 1 < argc) {
+			if (!parseColorFormat(argv[++i], arg == "--scene-format" ? sceneFormat : bloomFormat)) {
+				std::cerr << "Unknown target format " << argv[i] << ", expected rgba32f, rgba16f, rgb16f, r11f_g11f_b10f, rgb10_a2 or rgba8" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if (arg == "--compare-formats") {
+			compareFormats = true;
+		}
+		else if (arg == "--depth-prepass") {
+			useDepthPrepass = true;
+		}
+		else if (arg == "--bench-prepass") {
+			benchPrepassFrames = (i + 1 < argc && argv[i + 1][0] != '-') ? parseFlagValue<int>(arg, argv[++i], true) : 100;
+		}
+		else if (arg == "--deferred") {
+			useDeferred = true;
+		}
+		else if (arg == "--mesh-fireflies") {
+			useSprites = false;
+		}
+		else if (arg == "--no-sleep") {
+			allowSleep = false;
+		}
+		else if (arg == "--bench-emitters") {
+			benchmarkEmitters(2000000.0f, 0.5f, 300);
+			exit(EXIT_SUCCESS);
+		}
+		else if (arg == "--bench-integrators") {
+			benchmarkIntegrators(dtime, 1000);
+			exit(EXIT_SUCCESS);
+		}
+		else {
+			resources = arg;
+		}
+	}
 
 	// Initialize our new application
 	Application* application = new Application();
+	application->useGpuSimulation = useGpuSimulation;
+	application->integrator = integrator;
+	application->allowSleep = allowSleep;
+	application->useSprites = useSprites;
+	application->useDeferred = useDeferred;
+	application->useDepthPrepass = useDepthPrepass;
+	application->useDynamicResolution = useDynamicResolution;
+	application->resolution = resolution;
+	application->sceneFormat = sceneFormat;
+	application->bloomFormat = bloomFormat;
+	if (!trajectoryPath.empty()) {
+		application->trajectory = new TrajectoryWriter();
+		if (!application->trajectory->open(trajectoryPath, trajectoryQuantization)) {
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Headless replay: no window or GL, just the CPU simulation fed from the log
+	if (!replayPath.empty()) {
+		InputReplay* replay = new InputReplay();
+		if (!replay->load(replayPath)) {
+			exit(EXIT_FAILURE);
+		}
+		// Run as recorded, whatever the flags on this command line say
+		const RunSettings& settings = replay->getSettings();
+		if (settings.gpuSimulation) {
+			std::cerr << "'" << replayPath << "' was recorded with --gpu-sim, which headless replay can't run" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if (settings.integrator > (uint8_t) IntegratorType::Adaptive) {
+			std::cerr << "'" << replayPath << "' names an unknown integrator" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		application->integrator = (IntegratorType) settings.integrator;
+		application->allowSleep = settings.allowSleep;
+		dtime = settings.dt;
+		Random::setGlobalSeed(replay->getSeed());
+		application->rng.seed(replay->getSeed());
+		application->initializeFlowField();
+		application->initializeColliders(resources);
+		application->initializeEmitters(resources);
+		application->replay = replay;
+
+		while (application->simStep < replay->getEndStep()) {
+			application->update(dtime);
+		}
+		std::cout << "Replayed " << application->simStep << " steps, state checksum " << std::hex << application->stateChecksum() << std::dec << std::endl;
+		std::cout << application->fireflies.size() << " fireflies awake, " << application->sleep.getSleeping().size() << " asleep" << std::endl;
+		if (application->trajectory) application->trajectory->close();
+		exit(EXIT_SUCCESS);
+	}
+
+	// Print the seed so a run can be replayed with --seed
+	std::cout << "Random seed: " << seed << std::endl;
+	Random::setGlobalSeed(seed);
+	application->rng.seed(seed);
+	application->initializeFlowField();
+	application->initializeColliders(resources);
+	application->initializeEmitters(resources);
+
+	// Resume from the checkpoint if there is one
+	if (!checkpointPath.empty()) {
+		application->checkpointPath = checkpointPath;
+		application->checkpointInterval = checkpointInterval;
+		SimulationSnapshot snapshot;
+		if (loadCheckpoint(checkpointPath, snapshot)) {
+			application->restoreSnapshot(snapshot);
+			time = application->simTime;
+			std::cout << "Restored checkpoint at step " << snapshot.simStep << " with " << snapshot.fireflies.size() << " fireflies" << std::endl;
+			// A log replays from the seed alone, so it can't start from restored state
+			if (!recordPath.empty()) {
+				std::cerr << "Cannot --record a run resumed from checkpoint " << checkpointPath << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	if (!recordPath.empty()) {
+		application->recorder = new InputRecorder();
+		RunSettings settings;
+		settings.integrator = (uint8_t) integrator;
+		settings.dt = dtime;
+		settings.allowSleep = allowSleep;
+		settings.gpuSimulation = useGpuSimulation;
+		if (!application->recorder->open(recordPath, seed, settings)) {
+			exit(EXIT_FAILURE);
+		}
+	}
 
 	// Your main will always include a similar set up to establish your window
 	// and GL context, etc
@@ -613,6 +1859,16 @@ int main(int argc, char** argv)
 	// This is the code that will likely change program to program as you
 	// may need to initialize or set up different data and state
 	application->init(resources);
+	if (benchPrepassFrames > 0) {
+		application->benchmarkDepthPrepass(resources, time, benchPrepassFrames);
+		windowManager->shutdown();
+		exit(EXIT_SUCCESS);
+	}
+	if (compareFormats) {
+		application->compareTargetFormats(time, 30);
+		windowManager->shutdown();
+		exit(EXIT_SUCCESS);
+	}
 
 	// Loop until the user closes the window.
 	while (!glfwWindowShouldClose(windowManager->getHandle()))
@@ -627,6 +1883,20 @@ int main(int argc, char** argv)
 
 		time += dtime;
 	}
+	if (application->recorder) {
+		application->recorder->close(application->simStep);
+		// Compare against the --replay output of the same log
+		std::cout << "Recorded " << application->simStep << " steps, state checksum " << std::hex << application->stateChecksum() << std::dec << std::endl;
+	}
+	if (application->trajectory) {
+		application->trajectory->close();
+	}
+	if (!application->checkpointPath.empty()) {
+		// Final checkpoint so the next start resumes where we left off
+		application->checkpointWriter.wait();
+		application->saveCheckpoint();
+		application->checkpointWriter.wait();
+	}
 	// Quit program.
 	windowManager->shutdown();
 	exit(EXIT_SUCCESS);